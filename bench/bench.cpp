@@ -0,0 +1,246 @@
+// Benchmarks of the solver: whole greedy runs on every input, and the search
+// kernels and the output writer on their own. Build with ./scripts/build.sh bench.
+//
+//   ./bin/v5_bench [--input DIR] [--maps a,d] [--reps N] [--seed N]
+//                  [--baseline FILE] [--save FILE] [--threshold F]
+//
+// Each benchmark reports median and p95 wall time over the repetitions and
+// search queue pops per second; peak RSS is reported at the end. With a
+// baseline (default bench/baseline.json) the run fails when a median is more
+// than threshold slower than its baseline. --save writes the results in the
+// baseline format. Timings only compare on the same machine, so re-save the
+// baseline where the comparison runs. Without --maps only the maps in the
+// baseline run; the stored one covers a-d, as full greedy runs on e and f
+// take minutes each.
+#define V5_NO_MAIN
+#include "../v5.cpp"
+
+#include <map>
+#include <dirent.h>
+#include <sys/resource.h>
+
+struct BenchResult {
+	string name;
+	vector<double> ms;  // one entry per repetition
+	uint64_t pops = 0;  // per repetition
+	
+	double quantile(double q) const {
+		vector<double> v = ms;
+		sort(v.begin(), v.end());
+		// Nearest rank
+		const size_t k = max(1.0, ceil(q * v.size())) - 1;
+		return v[min(k, v.size() - 1)];
+	}
+	double median() const { return quantile(0.5); }
+	double p95() const { return quantile(0.95); }
+	double pops_per_s() const { return pops / (median() / 1000); }
+};
+
+// Times reps calls of fn, after one untimed call when warm is set. fn returns
+// the search queue pops it made.
+BenchResult bench(const string& name, int reps, bool warm, const function<uint64_t()>& fn) {
+	BenchResult r;
+	r.name = name;
+	if(warm) fn();
+	for(int k = 0; k < reps; ++k) {
+		auto t0 = chrono::steady_clock::now();
+		r.pops = fn();
+		auto t1 = chrono::steady_clock::now();
+		r.ms.push_back(chrono::duration<double, milli>(t1 - t0).count());
+	}
+	return r;
+}
+
+long peak_rss_kb() {
+	struct rusage u;
+	getrusage(RUSAGE_SELF, &u);
+#ifdef __APPLE__
+	return u.ru_maxrss / 1024;
+#else
+	return u.ru_maxrss;
+#endif
+}
+
+// Reads the medians of a file written by save_results, one benchmark per line
+map<string, double> load_baseline(const string& file) {
+	map<string, double> base;
+	ifstream in(file);
+	for(string line; getline(in, line); ) {
+		const size_t a = line.find('"'), b = line.find('"', a + 1), m = line.find("\"median_ms\":");
+		if(a == string::npos || b == string::npos || m == string::npos) continue;
+		base[line.substr(a + 1, b - a - 1)] = strtod(line.c_str() + m + 12, nullptr);
+	}
+	return base;
+}
+
+bool save_results(const string& file, const vector<BenchResult>& results) {
+	ofstream out(file);
+	out << fixed << setprecision(3);
+	out << "{\n  \"benchmarks\": {\n";
+	for(size_t k = 0; k < results.size(); ++k) {
+		const BenchResult& r = results[k];
+		out << "    \"" << r.name << "\": {\"median_ms\": " << r.median() << ", \"p95_ms\": " << r.p95()
+		    << ", \"pops_per_s\": " << setprecision(0) << r.pops_per_s() << setprecision(3) << "}"
+		    << (k + 1 < results.size() ? ",\n" : "\n");
+	}
+	out << "  },\n  \"peak_rss_kb\": " << peak_rss_kb() << "\n}\n";
+	return (bool)out;
+}
+
+// The kept tasks of one greedy run's initial state, with its arms on their mounts
+void initial_state(const Instance& in, const SolverParams& params, int seed, SolverState& st) {
+	mt19937 mt(seed);
+	init_state(in, params, mt, false, st);
+}
+
+int main(int argc, char* argv[]) {
+	string input_dir = "input", maps, baseline_file = "bench/baseline.json", save_file;
+	int reps = 3, seed = 1;
+	double threshold = 0.10;
+	for(int i = 1; i < argc; ++i) {
+		string arg = argv[i];
+		if(arg == "--input" && i+1 < argc) input_dir = argv[++i];
+		else if(arg == "--maps" && i+1 < argc) maps = argv[++i];
+		else if(arg == "--reps" && i+1 < argc) reps = max(1, stoi(argv[++i]));
+		else if(arg == "--seed" && i+1 < argc) seed = stoi(argv[++i]);
+		else if(arg == "--baseline" && i+1 < argc) baseline_file = argv[++i];
+		else if(arg == "--save" && i+1 < argc) save_file = argv[++i];
+		else if(arg == "--threshold" && i+1 < argc) threshold = stod(argv[++i]);
+		else {
+			cerr << "Usage: " << argv[0] << " [--input DIR] [--maps a,d] [--reps N] [--seed N]" << endl;
+			cerr << "       [--baseline FILE] [--save FILE] [--threshold F]" << endl;
+			return 1;
+		}
+	}
+	
+	// Read before running, so --save can replace the baseline it is compared with
+	const map<string, double> base = load_baseline(baseline_file);
+	
+	// The .txt instances of the input directory whose map letter is listed,
+	// by default those in the baseline, or all of them without one
+	vector<string> files;
+	if(DIR* d = opendir(input_dir.c_str())) {
+		while(dirent* e = readdir(d)) {
+			const string f = e->d_name;
+			if(f.size() < 5 || f.compare(f.size() - 4, 4, ".txt") != 0) continue;
+			if(!maps.empty() ? maps.find(f[0]) == string::npos
+			                 : !base.empty() && !base.count("greedy/" + f.substr(0, f.size() - 4))) continue;
+			files.push_back(f);
+		}
+		closedir(d);
+	}
+	sort(files.begin(), files.end());
+	if(files.empty()) {
+		cerr << "No instances in " << input_dir << endl;
+		return 1;
+	}
+	
+	const SolverParams params;
+	vector<BenchResult> results;
+	cout << left << setw(36) << "benchmark" << right << setw(12) << "median ms" << setw(12) << "p95 ms"
+	     << setw(12) << "Mpops/s" << endl;
+	auto report = [&](BenchResult r) {
+		cout << left << setw(36) << r.name << right << fixed << setprecision(3)
+		     << setw(12) << r.median() << setw(12) << r.p95()
+		     << setw(12) << r.pops_per_s() / 1e6 << endl;
+		results.push_back(move(r));
+	};
+	
+	for(const string& f : files) {
+		Instance in;
+		if(!in.load(input_dir + "/" + f)) {
+			cerr << "Could not open file: " << f << endl;
+			return 1;
+		}
+		const string map_name = f.substr(0, f.size() - 4);
+		const GridLayout g(in.W, in.H);
+		
+		// Whole greedy runs, as greedy_solver does them
+		SolverState solved;
+		report(bench("greedy/" + map_name, reps, false, [&]() {
+			SolverState st;
+			mt19937 mt(seed);
+			init_state(in, params, mt, false, st);
+			greedy_run(in, st, params, mt, false);
+			solved = move(st);
+			return solved.pops;
+		}));
+		
+		SolverState st;
+		initial_state(in, params, seed, st);
+		SearchScratch sc(in.W, in.H, in.L);
+		FanoutSearch fan(in.W, in.H, in.L);
+		
+		// The per-waypoint search alone: every kept task's first waypoint from
+		// the mount of arm t % R
+		report(bench("route/" + map_name, reps, true, [&]() {
+			const uint64_t pops = sc.Q.pops;
+			for(int t : st.keep) {
+				const int i = t % in.R;
+				SplitMix64 rng(seed ^ (uint64_t)t << 20);
+				sc.a.reset(st.arms[i]);
+				sc.route(g, st.resv, st.arms, i, in.L, in.P[t][0], in.P[t][0], in.Len[t], params, rng);
+			}
+			return sc.Q.pops - pops;
+		}));
+		
+		// The candidate loop of a first greedy step for up to 8 arms: the shared
+		// fan-out to all kept tasks, then the later waypoints of each task
+		const int arms = min(in.R, 8);
+		report(bench("candidates/" + map_name, reps, true, [&]() {
+			const uint64_t pops = sc.Q.pops + fan.Q.pops;
+			for(int i = 0; i < arms; ++i) {
+				fan.begin();
+				for(int t : st.keep) fan.want(g.id(in.P[t][0]));
+				SplitMix64 fan_rng(seed + i);
+				fan.run(g, st.resv, st.arms, i, in.L, params, fan_rng);
+				for(int t : st.keep) {
+					if(!fan.reachable(g.id(in.P[t][0]))) continue;
+					SplitMix64 rng(seed ^ (uint64_t)t << 20);
+					sc.a.reset(st.arms[i]);
+					const size_t first = fan.follow(sc.a, g, st.resv, st.arms, i, in.P[t][0]) ? 1 : 0;
+					int rest = in.Len[t];
+					for(size_t n = first; n < in.P[t].size(); ++n) {
+						if(n > 0) rest -= distance(in.P[t][n-1], in.P[t][n]);
+						if(!sc.route(g, st.resv, st.arms, i, in.L, in.P[t][0], in.P[t][n], rest, params, rng)) break;
+					}
+				}
+			}
+			return sc.Q.pops + fan.Q.pops - pops;
+		}));
+		
+		const string out = "/tmp/v5_bench_" + to_string(getpid()) + ".out";
+		report(bench("write_output/" + map_name, reps, true, [&]() {
+			write_output(solved.arms, out);
+			return (uint64_t)0;
+		}));
+		remove(out.c_str());
+	}
+	
+	cout << "Peak RSS: " << peak_rss_kb() / 1024 << " MB" << endl;
+	if(!save_file.empty() && !save_results(save_file, results)) {
+		cerr << "Could not write file: " << save_file << endl;
+		return 1;
+	}
+	
+	// Sub-millisecond medians are too noisy to hold against a baseline
+	if(base.empty()) return 0;
+	int regressions = 0;
+	cout << "\nAgainst " << baseline_file << " (threshold " << setprecision(0) << threshold * 100
+	     << "%):" << setprecision(3) << endl;
+	for(const BenchResult& r : results) {
+		auto it = base.find(r.name);
+		if(it == base.end() || it->second < 1.0) continue;
+		const double change = r.median() / it->second - 1;
+		const bool slow = change > threshold;
+		regressions += slow;
+		cout << left << setw(36) << r.name << right << setw(12) << it->second << setw(12) << r.median()
+		     << setw(9) << showpos << setprecision(1) << change * 100 << "%" << noshowpos << setprecision(3)
+		     << (slow ? "  REGRESSION" : "") << endl;
+	}
+	if(regressions > 0) {
+		cout << regressions << " benchmark(s) regressed" << endl;
+		return 1;
+	}
+	return 0;
+}
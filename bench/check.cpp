@@ -0,0 +1,126 @@
+// Checks of the solver's indexes against brute-force scans, on random point
+// sets and on the near_dist of every input. Build with ./scripts/build.sh check.
+//
+//   ./bin/v5_check [--input DIR] [--cases N] [--tasks N] [--seed N]
+//
+// Prints the first few mismatches of each check and exits 1 when any fails.
+#define V5_NO_MAIN
+#include "../v5.cpp"
+
+#include <dirent.h>
+
+struct Check {
+	string name;
+	int runs = 0, failed = 0;
+	
+	void expect(bool ok, const function<string()>& what) {
+		++ runs;
+		if(ok) return;
+		if(++ failed <= 5) cerr << name << ": " << what() << endl;
+	}
+	bool report() const {
+		cout << left << setw(28) << name << right << setw(8) << runs - failed << " / " << runs
+		     << (failed ? "  FAILED" : "") << endl;
+		return failed == 0;
+	}
+};
+
+string show(const Point& p) { return "(" + to_string(p.x) + "," + to_string(p.y) + ")"; }
+
+int brute_nearest(const vector<Point>& pts, const Point& p, int skip) {
+	int best = 1e8;
+	for(int k = 0; k < (int)pts.size(); ++k) if(k != skip) best = min(best, distance(p, pts[k]));
+	return best;
+}
+
+vi brute_nearest_k(const vector<Point>& pts, const Point& p, int k) {
+	vector<pair<int, int>> all;
+	for(int n = 0; n < (int)pts.size(); ++n) all.emplace_back(distance(p, pts[n]), n);
+	sort(all.begin(), all.end());
+	vi ids;
+	for(int n = 0; n < min(k, (int)all.size()); ++n) ids.push_back(all[n].second);
+	return ids;
+}
+
+// near_dist as the baseline defined it: the nearest other task end or mount
+int brute_near_dist(const Instance& in, int t) {
+	int best = 1e8;
+	for(int u = 0; u < in.T; ++u) if(u != t) best = min(best, distance(in.P[t][0], in.P[u].back()));
+	for(int m = 0; m < in.M; ++m) best = min(best, distance(in.P[t][0], in.ms[m]));
+	return best;
+}
+
+int main(int argc, char* argv[]) {
+	string input_dir = "input";
+	int cases = 2000, tasks = 1000, seed = 1;
+	for(int i = 1; i < argc; ++i) {
+		string arg = argv[i];
+		if(arg == "--input" && i+1 < argc) input_dir = argv[++i];
+		else if(arg == "--cases" && i+1 < argc) cases = max(0, stoi(argv[++i]));
+		else if(arg == "--tasks" && i+1 < argc) tasks = max(0, stoi(argv[++i]));
+		else if(arg == "--seed" && i+1 < argc) seed = stoi(argv[++i]);
+		else {
+			cerr << "Usage: " << argv[0] << " [--input DIR] [--cases N] [--tasks N] [--seed N]" << endl;
+			return 1;
+		}
+	}
+	mt19937 mt(seed);
+	
+	// Random boards from tiny to sparse, queried with and without a skipped id
+	Check nearest{"SpatialIndex::nearest"}, nearest_k{"SpatialIndex::nearest_k"};
+	for(int c = 0; c < cases; ++c) {
+		const int W = 1 + mt() % 300, H = 1 + mt() % 300, n = mt() % 200;
+		vector<Point> pts(n);
+		for(Point& p : pts) p = Point(mt() % W, mt() % H);
+		SpatialIndex index(W, H, max(1, (int)(mt() % (n + 1))));
+		for(int k = 0; k < n; ++k) index.insert(pts[k], k);
+		
+		const Point q(mt() % W, mt() % H);
+		const int skip = n > 0 && mt() % 2 ? mt() % n : -1;
+		const int got = index.nearest(q, skip), want = brute_nearest(pts, q, skip);
+		nearest.expect(got == want, [&] {
+			return "case " + to_string(c) + " " + show(q) + ": " + to_string(got) + ", expected " + to_string(want);
+		});
+		
+		const int k = 1 + mt() % 8;
+		vi ids;
+		index.nearest_k(q, k, ids);
+		const vi want_ids = brute_nearest_k(pts, q, k);
+		nearest_k.expect(ids == want_ids, [&] {
+			return "case " + to_string(c) + " " + show(q) + " k=" + to_string(k) + ": ids differ";
+		});
+	}
+	bool ok = nearest.report();
+	ok &= nearest_k.report();
+	
+	// near_dist of every input against the brute-force definition, on a
+	// sample of tasks for the large ones
+	vector<string> files;
+	if(DIR* d = opendir(input_dir.c_str())) {
+		while(dirent* e = readdir(d)) {
+			const string f = e->d_name;
+			if(f.size() >= 5 && f.compare(f.size() - 4, 4, ".txt") == 0) files.push_back(f);
+		}
+		closedir(d);
+	}
+	sort(files.begin(), files.end());
+	for(const string& f : files) {
+		Instance in;
+		if(!in.load(input_dir + "/" + f)) {
+			cerr << "Could not open file: " << f << endl;
+			return 1;
+		}
+		Check near{"near_dist/" + f.substr(0, f.size() - 4)};
+		const int n = min(tasks, in.T);
+		for(int k = 0; k < n; ++k) {
+			const int t = n == in.T ? k : mt() % in.T;
+			const int want = brute_near_dist(in, t);
+			near.expect(in.near_dist[t] == want, [&] {
+				return "task " + to_string(t) + ": " + to_string(in.near_dist[t]) + ", expected " + to_string(want);
+			});
+		}
+		ok &= near.report();
+	}
+	
+	return ok ? 0 : 1;
+}
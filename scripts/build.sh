@@ -1,7 +1,7 @@
 #!/bin/bash
 
 # Build script for v5.cpp - Works on Mac and Linux
-# Usage: ./scripts/build.sh [release|debug]
+# Usage: ./scripts/build.sh [release|debug|bench|check|profile]
 
 set -e  # Exit on error
 
@@ -27,7 +27,19 @@ case "${OS}" in
     *)          echo -e "${RED}Error: Unsupported OS: ${OS}${NC}" >&2; exit 1;;
 esac
 
-echo -e "${GREEN}Building v5.cpp for ${OS_TYPE}...${NC}"
+# Source and output files (bench builds the benchmark harness, check the
+# brute-force checks instead)
+SOURCE_FILE="v5.cpp"
+OUTPUT_FILE="bin/v5"
+if [ "$BUILD_MODE" = "bench" ]; then
+    SOURCE_FILE="bench/bench.cpp"
+    OUTPUT_FILE="bin/v5_bench"
+elif [ "$BUILD_MODE" = "check" ]; then
+    SOURCE_FILE="bench/check.cpp"
+    OUTPUT_FILE="bin/v5_check"
+fi
+
+echo -e "${GREEN}Building ${SOURCE_FILE} for ${OS_TYPE}...${NC}"
 
 # Detect compiler
 if command -v g++ &> /dev/null; then
@@ -45,20 +57,20 @@ echo -e "Compiler: ${COMPILER_VERSION}"
 
 # Set compiler flags based on build mode
 if [ "$BUILD_MODE" = "debug" ]; then
-    CXXFLAGS="-std=c++17 -Wall -Wextra -g -O0 -DDEBUG"
+    CXXFLAGS="-std=c++17 -Wall -Wextra -g -O0 -DDEBUG -pthread"
     echo -e "${YELLOW}Build mode: DEBUG${NC}"
+elif [ "$BUILD_MODE" = "profile" ]; then
+    # Release build with the hot-path counters and phase timers written to output/*.json
+    CXXFLAGS="-std=c++17 -Wall -Wextra -O3 -DNDEBUG -DV5_PROFILE -pthread"
+    echo -e "${YELLOW}Build mode: PROFILE${NC}"
 else
-    CXXFLAGS="-std=c++17 -Wall -Wextra -O3 -DNDEBUG"
+    CXXFLAGS="-std=c++17 -Wall -Wextra -O3 -DNDEBUG -pthread"
     echo -e "${GREEN}Build mode: RELEASE${NC}"
 fi
 
 # Create bin directory if it doesn't exist
 mkdir -p bin
 
-# Source and output files
-SOURCE_FILE="v5.cpp"
-OUTPUT_FILE="bin/v5"
-
 # Compile
 echo -e "Compiling ${SOURCE_FILE}..."
 echo -e "Command: ${COMPILER} ${CXXFLAGS} -o ${OUTPUT_FILE} ${SOURCE_FILE}"
@@ -80,7 +92,13 @@ if ${COMPILER} ${CXXFLAGS} -o "${OUTPUT_FILE}" "${SOURCE_FILE}"; then
     echo -e "Output: ${OUTPUT_FILE}"
     echo -e "Size: ${SIZE_MB} MB"
     echo -e ""
-    echo -e "Run with: ${OUTPUT_FILE} -m <map> [options]"
+    if [ "$BUILD_MODE" = "bench" ]; then
+        echo -e "Run with: ${OUTPUT_FILE} [--maps a,d] [--reps N] [--save FILE]"
+    elif [ "$BUILD_MODE" = "check" ]; then
+        echo -e "Run with: ${OUTPUT_FILE} [--input DIR] [--cases N]"
+    else
+        echo -e "Run with: ${OUTPUT_FILE} -m <map> [options]"
+    fi
 else
     echo -e "${RED}✗ Build failed!${NC}" >&2
     exit 1
@@ -1,7 +1,6 @@
 #include <iostream>
 #include <vector>
 #include <numeric>
-#include <queue>
 #include <tuple>
 #include <random>
 #include <algorithm>
@@ -11,6 +10,25 @@
 #include <sstream>
 #include <cstring>
 #include <iomanip>
+#include <cstdint>
+#include <climits>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <deque>
+#include <map>
+#include <cstdio>
+#include <cerrno>
+#include <charconv>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 
 using namespace std;
 typedef vector<int> vi;
@@ -22,13 +40,14 @@ struct SolverParams {
 	double ownership_distance_factor = 2.0;   // 1.0 to 5.0
 	double path_cost_threshold = 1.0;         // 0.5 to 2.0
 	double bfs_randomness = 0.5;              // 0.0 to 1.0
+	int candidate_k = 0;                      // nearest tasks considered per step, 0 for all; not tuned
 	
-	void print() const {
-		cerr << "Params(eff=" << task_efficiency_weight 
-		     << ", dist=" << distance_penalty
-		     << ", own=" << ownership_distance_factor
-		     << ", thresh=" << path_cost_threshold
-		     << ", rand=" << bfs_randomness << ")" << endl;
+	void print(ostream& out = cerr) const {
+		out << "Params(eff=" << task_efficiency_weight 
+		    << ", dist=" << distance_penalty
+		    << ", own=" << ownership_distance_factor
+		    << ", thresh=" << path_cost_threshold
+		    << ", rand=" << bfs_randomness << ")" << endl;
 	}
 	
 	SolverParams mutate(mt19937& mt, double temperature = 0.2, 
@@ -38,6 +57,7 @@ struct SolverParams {
 	                   bool fix_path_threshold = false,
 	                   bool fix_bfs_random = false) const {
 		SolverParams p;
+		p.candidate_k = candidate_k;
 		normal_distribution<double> dist(0.0, 1.0);
 		
 		if(fix_task_eff) {
@@ -87,7 +107,7 @@ struct ParamFixFlags {
 	bool fix_path_threshold = false;
 	bool fix_bfs_random = false;
 	
-	void print() const {
+	void print(ostream& out = cout) const {
 		vector<string> fixed;
 		if(fix_task_eff) fixed.push_back("task-eff");
 		if(fix_dist_penalty) fixed.push_back("dist-penalty");
@@ -96,18 +116,71 @@ struct ParamFixFlags {
 		if(fix_bfs_random) fixed.push_back("bfs-random");
 		
 		if(fixed.empty()) {
-			cout << "All parameters will be randomized" << endl;
+			out << "All parameters will be randomized" << endl;
 		} else {
-			cout << "Fixed parameters: ";
+			out << "Fixed parameters: ";
 			for(size_t i = 0; i < fixed.size(); ++i) {
-				if(i > 0) cout << ", ";
-				cout << fixed[i];
+				if(i > 0) out << ", ";
+				out << fixed[i];
 			}
-			cout << endl;
+			out << endl;
 		}
 	}
 };
 
+// ==================== Profiling ====================
+// Hot-path counters and phase timers, compiled in with -DV5_PROFILE
+// (./scripts/build.sh profile). Without it the PROF_ macros expand to nothing.
+struct Profile {
+	atomic<uint64_t> heap_pushes{0}, heap_pops{0};
+	atomic<uint64_t> candidates{0}, failed_candidates{0};
+	atomic<uint64_t> arm_copies{0}, arm_copy_bytes{0};
+	atomic<uint64_t> retraction_steps{0};
+	atomic<uint64_t> preprocess_ns{0}, search_ns{0}, commit_ns{0}, output_ns{0};
+	
+	void write_json(ostream& out) const {
+		auto sec = [](const atomic<uint64_t>& ns) { return ns.load() / 1e9; };
+		out << "  \"profile\": {\n";
+		out << "    \"heap_pushes\": " << heap_pushes << ",\n";
+		out << "    \"heap_pops\": " << heap_pops << ",\n";
+		out << "    \"candidates\": " << candidates << ",\n";
+		out << "    \"failed_candidates\": " << failed_candidates << ",\n";
+		out << "    \"arm_copies\": " << arm_copies << ",\n";
+		out << "    \"arm_copy_bytes\": " << arm_copy_bytes << ",\n";
+		out << "    \"retraction_steps\": " << retraction_steps << ",\n";
+		out << "    \"preprocess_s\": " << sec(preprocess_ns) << ",\n";
+		out << "    \"candidate_search_s\": " << sec(search_ns) << ",\n";
+		out << "    \"commit_s\": " << sec(commit_ns) << ",\n";
+		out << "    \"output_s\": " << sec(output_ns) << "\n";
+		out << "  }";
+	}
+} profile;
+
+// Adds the time from construction to stop() or destruction, whichever is first
+class ProfileTimer {
+	atomic<uint64_t>* total;
+	chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+public:
+	explicit ProfileTimer(atomic<uint64_t>& total): total(&total) {}
+	~ProfileTimer() { stop(); }
+	void stop() {
+		if(!total) return;
+		total->fetch_add(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - t0).count(),
+		                 memory_order_relaxed);
+		total = nullptr;
+	}
+};
+
+#ifdef V5_PROFILE
+#define PROF_COUNT(name, n) profile.name.fetch_add((n), memory_order_relaxed)
+#define PROF_TIMER(name) ProfileTimer prof_##name(profile.name)
+#define PROF_STOP(name) prof_##name.stop()
+#else
+#define PROF_COUNT(name, n) ((void)0)
+#define PROF_TIMER(name) ((void)0)
+#define PROF_STOP(name) ((void)0)
+#endif
+
 // ==================== Core Structures ====================
 struct Point {
 	int x, y;
@@ -132,18 +205,139 @@ struct Point {
 		}
 		return *this;
 	}
-	inline Point operator+(char c) { return Point(*this) += c; }
+	inline Point operator+(char c) const { return Point(*this) += c; }
+};
+
+// Open-addressed cell -> direction map for the cells an arm occupies.
+// Absent cells read as 'x' and storing 'x' erases the cell, so the map
+// stays at O(cur.size()) entries instead of a dense W*H grid per arm.
+struct CellMap {
+	vi keys;
+	string vals;
+	int n = 0, shift = 28;
+	
+	CellMap(): keys(16, -1), vals(16, 'x') {}
+	
+	static inline int key(const Point& p) { return p.x << 16 | p.y; }
+	inline unsigned home(int k) const { return ((unsigned)k * 2654435769u) >> shift; }
+	inline unsigned mask() const { return keys.size() - 1; }
+	
+	inline char get(const Point& p) const {
+		const int k = key(p);
+		for(unsigned s = home(k); ; s = (s + 1) & mask()) {
+			if(keys[s] == k) return vals[s];
+			if(keys[s] == -1) return 'x';
+		}
+	}
+	
+	void set(const Point& p, char c) {
+		const int k = key(p);
+		unsigned s = home(k);
+		while(keys[s] != -1 && keys[s] != k) s = (s + 1) & mask();
+		if(c != 'x') {
+			if(keys[s] == -1) {
+				if(2 * (n + 1) > (int)keys.size()) { grow(); set(p, c); return; }
+				keys[s] = k;
+				++ n;
+			}
+			vals[s] = c;
+			return;
+		}
+		if(keys[s] == -1) return;
+		// Backward-shift deletion keeps probe chains intact without tombstones
+		-- n;
+		for(unsigned j = s; ; ) {
+			j = (j + 1) & mask();
+			if(keys[j] == -1) break;
+			if(((j - home(keys[j])) & mask()) >= ((j - s) & mask())) {
+				keys[s] = keys[j];
+				vals[s] = vals[j];
+				s = j;
+			}
+		}
+		keys[s] = -1;
+		vals[s] = 'x';
+	}
+	
+	void grow() {
+		vi old_keys = move(keys);
+		string old_vals = move(vals);
+		keys.assign(old_keys.size() * 2, -1);
+		vals.assign(old_vals.size() * 2, 'x');
+		-- shift;
+		n = 0;
+		for(size_t s = 0; s < old_keys.size(); ++s) if(old_keys[s] != -1) {
+			const int k = old_keys[s];
+			set(Point(k >> 16, k & 0xFFFF), old_vals[s]);
+		}
+	}
+};
+
+// Timeline of an arm as (move, count) runs. Waits come in long stretches, so
+// a stretch costs one run instead of one char per step. size() is O(1).
+struct Path {
+	struct Run {
+		char c;
+		int n;
+	};
+	vector<Run> runs;
+	int len = 0;
+	
+	inline size_t size() const { return len; }
+	inline bool empty() const { return len == 0; }
+	void clear() {
+		runs.clear();
+		len = 0;
+	}
+	void append(int n, char c) {
+		if(n <= 0) return;
+		if(!runs.empty() && runs.back().c == c) runs.back().n += n;
+		else runs.push_back({c, n});
+		len += n;
+	}
+	inline void push_back(char c) { append(1, c); }
+	inline Path& operator+=(char c) {
+		append(1, c);
+		return *this;
+	}
+	Path& operator+=(const Path& o) {
+		for(const Run& r : o.runs) append(r.n, r.c);
+		return *this;
+	}
+	
+	// Calls f(l, c) for every step, l counting from start
+	template<class F> void each(int start, F f) const {
+		int l = start;
+		for(const Run& r : runs) for(int k = 0; k < r.n; ++k) f(l++, r.c);
+	}
 };
 
 struct Arm {
-	vector<string> how;
-	string path, cp;
+	CellMap how;
+	Path path;
+	string cp;
 	vector<Point> cur;
 	vi z;
 	int i;
 	bool done;
 	Arm() = default;
-	Arm(int W, int H, int x, int y, int i): how(W, string(H, 'x')), cur(1, Point(x, y)), i(i), done(false) {}
+	Arm(int x, int y, int i): cur(1, Point(x, y)), i(i), done(false) {}
+#ifdef V5_PROFILE
+	// Copies are counted, moves stay free
+	Arm(const Arm& o): how(o.how), path(o.path), cp(o.cp), cur(o.cur), z(o.z), i(o.i), done(o.done) { counted(); }
+	Arm(Arm&&) = default;
+	Arm& operator=(const Arm& o) {
+		how = o.how; path = o.path; cp = o.cp; cur = o.cur; z = o.z; i = o.i; done = o.done;
+		counted();
+		return *this;
+	}
+	Arm& operator=(Arm&&) = default;
+	void counted() const {
+		PROF_COUNT(arm_copies, 1);
+		PROF_COUNT(arm_copy_bytes, how.keys.size() * sizeof(int) + how.vals.size() + path.runs.size() * sizeof(Path::Run)
+		                           + cp.size() + cur.size() * sizeof(Point) + z.size() * sizeof(int));
+	}
+#endif
 };
 
 char opp(char c) {
@@ -154,38 +348,1001 @@ char opp(char c) {
 	return c;
 }
 
-// ==================== Solver ====================
-int greedy_solver(int W, int H, int R, int M, int T, int L,
-                  vector<Point>& ms, vi& S, vector<vector<Point>>& P, vi& Len,
-                  vector<Arm>& arms, const SolverParams& params,
-                  mt19937& mt, bool verbose) {
+// What a candidate did to an arm: the base cur/cp prefix it kept plus what it appended
+struct ArmDelta {
+	size_t keep = 0;
+	vector<Point> cur_add;
+	string cp_add;
+	Path path_add;
 	
-	int score = 0;
-	vector<vi> owner(W, vi(H, -1));
-	vector<vi> until(W, vi(H, -1));
-	vi ts(T); iota(ts.begin(), ts.end(), 0);
+	void apply(Arm& a) const {
+		while(a.cur.size() > keep) {
+			a.cur.pop_back();
+			a.cp.pop_back();
+			a.how.set(a.cur.back(), 'x');
+		}
+		for(size_t k = 0; k < cur_add.size(); ++k) {
+			a.how.set(a.cur.back(), opp(cp_add[k]));
+			a.cur.push_back(cur_add[k]);
+		}
+		a.cp += cp_add;
+		a.path += path_add;
+	}
+};
+
+// Inclusive cell rectangle, empty until the first point is added
+struct Box {
+	int x0 = 1 << 30, y0 = 1 << 30, x1 = -1, y1 = -1;
 	
-	// Filter tasks with distance penalty (optimized - cache results)
-	vi min_dist_to_other_task(T, 1e8);
-	vi min_dist_to_mount(T, 1e8);
-	for(int i = 0; i < T; ++i) {
-		for(int j = 0; j < T; ++j) {
-			if(i != j) {
-				int d = distance(P[i][0], P[j].back());
-				min_dist_to_other_task[i] = min(min_dist_to_other_task[i], d);
+	inline bool empty() const { return x0 > x1; }
+	inline void add(const Point& p) {
+		x0 = min(x0, p.x);
+		y0 = min(y0, p.y);
+		x1 = max(x1, p.x);
+		y1 = max(y1, p.y);
+	}
+	inline bool overlaps(const Box& o) const {
+		return x0 <= o.x1 && o.x0 <= x1 && y0 <= o.y1 && o.y0 <= y1;
+	}
+	void grow(int r) {
+		if(empty()) return;
+		x0 -= r;
+		y0 -= r;
+		x1 += r;
+		y1 += r;
+	}
+};
+
+// ==================== Grid Layer ====================
+const char DIRS[4] = {'R', 'L', 'U', 'D'};
+
+// Per-cell solver state lives in flat arrays indexed by id = x * H + y, with
+// the fields the search expansion reads together packed into one record.
+struct Reservation {
+	int owner = -1, until = -1;
+};
+
+struct SearchCell {
+	int seen = 0, dist = 0;
+	char pred = 'x';
+};
+
+struct GridLayout {
+	int W, H;
+	int off[4];                    // id offset of a step in DIRS[k]
+	vector<unsigned char> border;  // bit k set when DIRS[k] stays inside the grid
+	
+	GridLayout(int W, int H): W(W), H(H), off{H, -H, 1, -1}, border(W * H, 0) {
+		for(int x = 0; x < W; ++x) {
+			for(int y = 0; y < H; ++y) {
+				border[x * H + y] = (x + 1 < W) | (x > 0) << 1 | (y + 1 < H) << 2 | (y > 0) << 3;
+			}
+		}
+	}
+	inline int id(const Point& p) const { return p.x * H + p.y; }
+};
+
+// ==================== Spatial Index ====================
+// Uniform buckets over points with ids. Queries walk square rings of buckets
+// outwards from the query bucket and stop once no unvisited bucket can hold a
+// closer point: a bucket r+1 rings out is more than r*B away.
+struct SpatialIndex {
+	struct Entry {
+		Point p;
+		int id;
+	};
+	
+	int B, BW, BH;
+	vector<vector<Entry>> bucket;
+	
+	// Buckets are sized for about one point each
+	SpatialIndex(int W, int H, int n): B(max(1, (int)sqrt((double)W * H / max(1, n)))),
+		BW((W + B - 1) / B), BH((H + B - 1) / B), bucket(BW * BH) {}
+	
+	inline vector<Entry>& at(const Point& p) { return bucket[p.x / B * BH + p.y / B]; }
+	
+	void insert(const Point& p, int id) { at(p).push_back({p, id}); }
+	void erase(const Point& p, int id) {
+		vector<Entry>& b = at(p);
+		for(size_t k = 0; k < b.size(); ++k) if(b[k].id == id) {
+			b[k] = b.back();
+			b.pop_back();
+			return;
+		}
+	}
+	
+	template<class F> void ring(int bx, int by, int r, F visit) const {
+		auto cell = [&](int x, int y) {
+			if(x < 0 || x >= BW || y < 0 || y >= BH) return;
+			for(const Entry& e : bucket[x * BH + y]) visit(e);
+		};
+		if(r == 0) {
+			cell(bx, by);
+			return;
+		}
+		for(int x = bx - r; x <= bx + r; ++x) {
+			cell(x, by - r);
+			cell(x, by + r);
+		}
+		for(int y = by - r + 1; y < by + r; ++y) {
+			cell(bx - r, y);
+			cell(bx + r, y);
+		}
+	}
+	inline int rings(int bx, int by) const { return max({bx, BW - 1 - bx, by, BH - 1 - by}); }
+	
+	// Distance to the nearest point whose id is not skip, 1e8 when there is none
+	int nearest(const Point& p, int skip = -1) const {
+		int best = 1e8;
+		const int bx = p.x / B, by = p.y / B;
+		// Ring r is more than (r-1)*B away, so it can only help while best is larger
+		for(int r = 0, rmax = rings(bx, by); r <= rmax && (r == 0 || best > (r - 1) * B); ++r) {
+			ring(bx, by, r, [&](const Entry& e) {
+				if(e.id != skip) best = min(best, distance(p, e.p));
+			});
+		}
+		return best;
+	}
+	
+	// Ids of the k nearest points, closest first and lower id on ties
+	void nearest_k(const Point& p, int k, vi& out) const {
+		vector<pair<int, int>> found;
+		const int bx = p.x / B, by = p.y / B;
+		for(int r = 0, rmax = rings(bx, by); r <= rmax; ++r) {
+			ring(bx, by, r, [&](const Entry& e) { found.emplace_back(distance(p, e.p), e.id); });
+			if((int)found.size() >= k) {
+				nth_element(found.begin(), found.begin() + k - 1, found.end());
+				if(found[k-1].first <= r * B) break;
+			}
+		}
+		sort(found.begin(), found.end());
+		if((int)found.size() > k) found.resize(k);
+		out.clear();
+		for(const auto& f : found) out.push_back(f.second);
+	}
+};
+
+// ==================== Instance ====================
+// Read-only view of a contiguous array, backed by the instance's own vectors
+// or by the mapped cache file
+template<class T> struct View {
+	const T* p = nullptr;
+	size_t n = 0;
+	
+	View() {}
+	View(const T* p, size_t n): p(p), n(n) {}
+	View(const vector<T>& v): p(v.data()), n(v.size()) {}
+	inline const T& operator[](size_t i) const { return p[i]; }
+	inline size_t size() const { return n; }
+	inline const T* begin() const { return p; }
+	inline const T* end() const { return p + n; }
+	inline const T& back() const { return p[n-1]; }
+};
+
+// Waypoints of all tasks in one array, task t spans pts[off[t] .. off[t+1])
+struct Waypoints {
+	View<int> off;
+	View<Point> pts;
+	
+	inline View<Point> operator[](int t) const { return {pts.p + off[t], (size_t)(off[t+1] - off[t])}; }
+	inline int size() const { return (int)off.size() - 1; }
+};
+
+// Compiled form of an input file, written next to it as <input>.bin. Arrays
+// follow the header in this order: ms[M], S[T], off[T+1], pts[NP], Len[T],
+// near_dist[T]. Points are stored as x, y pairs so the file maps onto Point.
+struct CacheHeader {
+	char magic[8];
+	uint32_t version, pad;
+	uint64_t src_size;
+	int64_t src_mtime;
+	int32_t W, H, R, M, T, L;
+	int64_t NP;
+};
+static_assert(sizeof(Point) == 2 * sizeof(int32_t), "cache maps Point as two int32");
+const char CACHE_MAGIC[8] = {'V', '5', 'I', 'N', 'S', 'T', '\0', '\0'};
+// The cache holds results of precompute(), not only parsed input, so this
+// goes up whenever the layout or how any stored array is computed changes
+const uint32_t CACHE_VERSION = 2;
+
+// Parsed input plus everything that does not depend on SolverParams. Built
+// once, then shared read-only by every evaluation and thread.
+struct Instance {
+	int W = 0, H = 0, R = 0, M = 0, T = 0, L = 0;
+	View<Point> ms;
+	View<int> S;
+	Waypoints P;
+	View<int> Len;              // Manhattan length through P[t]
+	View<int> near_dist;        // from P[t][0] to the nearest other task end or mount
+	vector<Box> task_box;       // bounding box of P[t]
+	vector<Point> ms_by_border; // mounts closest to the border first
+	
+	Instance() {}
+	Instance(const Instance&) = delete;
+	Instance& operator=(const Instance&) = delete;
+	~Instance() { if(map) munmap(map, map_size); }
+	
+	// Maps the cache when it matches the source file, otherwise parses the
+	// text and writes a fresh cache for the next run
+	bool load(const string& file) {
+		struct stat st;
+		if(stat(file.c_str(), &st) != 0) return false;
+		const string cache = file + ".bin";
+		if(map_cache(cache, st)) {
+			if(!valid()) return false;
+			derive();
+			return true;
+		}
+		if(!parse_text(file) || !valid()) return false;
+		precompute();
+		derive();
+		write_cache(cache, st);
+		return true;
+	}
+	
+	// Sizes the solver can allocate for, at least as many mounts as arms, and
+	// every mount and waypoint on the board
+	bool valid() const {
+		if(W < 1 || H < 1 || (int64_t)W * H > (1 << 26) || R < 1 || R > M || T < 0 || L < 0) return false;
+		auto inside = [&](const Point& p) { return p.x >= 0 && p.x < W && p.y >= 0 && p.y < H; };
+		for(const Point& m : ms) if(!inside(m)) return false;
+		for(int t = 0; t < T; ++t) if(P[t].size() == 0) return false;
+		for(const Point& p : P.pts) if(!inside(p)) return false;
+		return true;
+	}
+	
+	// FNV-1a over the parsed input, so saved state can tell which instance it belongs to
+	uint64_t fingerprint() const {
+		uint64_t h = 0xCBF29CE484222325ull;
+		auto mix = [&](const void* p, size_t n) {
+			const unsigned char* c = (const unsigned char*)p;
+			for(size_t k = 0; k < n; ++k) h = (h ^ c[k]) * 0x100000001B3ull;
+		};
+		const int32_t dims[6] = {W, H, R, M, T, L};
+		mix(dims, sizeof dims);
+		mix(ms.begin(), sizeof(Point) * ms.size());
+		mix(S.begin(), sizeof(int) * S.size());
+		mix(P.off.begin(), sizeof(int) * P.off.size());
+		mix(P.pts.begin(), sizeof(Point) * P.pts.size());
+		return h;
+	}
+
+private:
+	vector<Point> own_ms, own_pts;
+	vi own_S, own_off, own_Len, own_near;
+	void* map = nullptr;
+	size_t map_size = 0;
+	
+	// Hand-rolled scanner over the whole file, the input is nothing but integers
+	bool parse_text(const string& file) {
+		FILE* f = fopen(file.c_str(), "rb");
+		if(!f) return false;
+		string buf;
+		char chunk[1 << 16];
+		for(size_t n; (n = fread(chunk, 1, sizeof chunk, f)) > 0; ) buf.append(chunk, n);
+		fclose(f);
+		
+		// Fails on a missing or out of range number; counts are bounded by the
+		// file size so a bad one cannot allocate more than the file could fill
+		const char* c = buf.c_str();
+		bool ok = true;
+		auto next = [&]() {
+			while(*c && (*c < '0' || *c > '9') && *c != '-') ++c;
+			bool neg = *c == '-';
+			if(neg) ++c;
+			if(*c < '0' || *c > '9') ok = false;
+			int64_t v = 0;
+			while(*c >= '0' && *c <= '9') {
+				v = v * 10 + (*c++ - '0');
+				if(v > INT_MAX) ok = false, v = 0;
+			}
+			return (int)(neg ? -v : v);
+		};
+		auto count = [&](int n) {
+			if(n < 0 || (size_t)n > buf.size()) ok = false;
+			return ok ? n : 0;
+		};
+		W = next(); H = next(); R = next(); M = count(next()); T = count(next()); L = next();
+		own_ms.resize(M);
+		for(Point& m : own_ms) {
+			m.x = next();
+			m.y = next();
+		}
+		own_S.resize(T);
+		own_off.assign(1, 0);
+		own_pts.clear();
+		for(int t = 0; t < T && ok; ++t) {
+			own_S[t] = next();
+			for(int p = count(next()); p > 0 && ok; --p) {
+				const int x = next();
+				own_pts.emplace_back(x, next());
 			}
+			if(own_pts.size() > buf.size()) ok = false;
+			own_off.push_back(own_pts.size());
+		}
+		if(!ok) return false;
+		ms = own_ms;
+		S = own_S;
+		P = {View<int>(own_off), View<Point>(own_pts)};
+		return true;
+	}
+	
+	void precompute() {
+		own_Len.assign(T, 0);
+		for(int t = 0; t < T; ++t) {
+			for(int k = 1; k < (int)P[t].size(); ++k) own_Len[t] += distance(P[t][k-1], P[t][k]);
 		}
-		for(const Point &m : ms) {
-			int d = distance(P[i][0], m);
-			min_dist_to_mount[i] = min(min_dist_to_mount[i], d);
+		
+		// How far a task's start is from where an arm could be when it picks
+		// it up: the end of another task or a mount
+		SpatialIndex task_ends(W, H, T), mounts(W, H, M);
+		for(int t = 0; t < T; ++t) task_ends.insert(P[t].back(), t);
+		for(int m = 0; m < M; ++m) mounts.insert(ms[m], m);
+		own_near.resize(T);
+		for(int t = 0; t < T; ++t) own_near[t] = min(task_ends.nearest(P[t][0], t), mounts.nearest(P[t][0]));
+		Len = own_Len;
+		near_dist = own_near;
+	}
+	
+	// Cheap per-run data kept out of the cache
+	void derive() {
+		task_box.assign(T, Box());
+		for(int t = 0; t < T; ++t) for(const Point& p : P[t]) task_box[t].add(p);
+		
+		vi ms_dist(M), ms_indices(M);
+		for(int i = 0; i < M; ++i) {
+			ms_dist[i] = min({ms[i].x, W-1-ms[i].x, ms[i].y, H-1-ms[i].y});
+		}
+		iota(ms_indices.begin(), ms_indices.end(), 0);
+		sort(ms_indices.begin(), ms_indices.end(), [&](int i, int j) {
+			return ms_dist[i] < ms_dist[j];
+		});
+		ms_by_border.resize(M);
+		for(int i = 0; i < M; ++i) ms_by_border[i] = ms[ms_indices[i]];
+	}
+	
+	static size_t cache_size(const CacheHeader& h) {
+		return sizeof(CacheHeader) + sizeof(Point) * (h.M + h.NP) + sizeof(int32_t) * (4 * (size_t)h.T + 1);
+	}
+	
+	bool map_cache(const string& cache, const struct stat& src) {
+		const int fd = open(cache.c_str(), O_RDONLY);
+		if(fd < 0) return false;
+		struct stat st;
+		void* m = MAP_FAILED;
+		if(fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(CacheHeader)) {
+			m = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		}
+		close(fd);
+		if(m == MAP_FAILED) return false;
+		
+		const CacheHeader& h = *(const CacheHeader*)m;
+		const char* c = (const char*)m + sizeof(CacheHeader);
+		// Counts are bounded by the file size before cache_size() multiplies them
+		const int64_t n = st.st_size;
+		bool ok = memcmp(h.magic, CACHE_MAGIC, 8) == 0 && h.version == CACHE_VERSION &&
+		          h.src_size == (uint64_t)src.st_size && h.src_mtime == (int64_t)src.st_mtime &&
+		          h.W > 0 && h.H > 0 && h.M >= 0 && h.T >= 0 && h.NP >= 0 &&
+		          h.M < n && h.T < n && h.NP < n && cache_size(h) == (size_t)n;
+		// Every task's waypoints must lie inside pts[NP]
+		const int* off = ok ? (const int*)(c + sizeof(Point) * h.M + sizeof(int32_t) * h.T) : nullptr;
+		ok = ok && off[0] == 0 && off[h.T] == h.NP;
+		for(int t = 0; ok && t < h.T; ++t) ok = off[t] <= off[t+1];
+		if(!ok) {
+			munmap(m, st.st_size);
+			return false;
 		}
-		Len[i] += (int)(min(min_dist_to_other_task[i], min_dist_to_mount[i]) * params.distance_penalty);
+		map = m;
+		map_size = st.st_size;
+		W = h.W; H = h.H; R = h.R; M = h.M; T = h.T; L = h.L;
+		ms = take<Point>(c, M);
+		S = take<int>(c, T);
+		P.off = take<int>(c, T + 1);
+		P.pts = take<Point>(c, h.NP);
+		Len = take<int>(c, T);
+		near_dist = take<int>(c, T);
+		return true;
+	}
+	
+	template<class E> static View<E> take(const char*& c, size_t n) {
+		View<E> v((const E*)c, n);
+		c += sizeof(E) * n;
+		return v;
+	}
+	
+	// Written under a temporary name and renamed, so parallel runs never map a
+	// half-written cache. Failing to write it only costs the next run a parse.
+	void write_cache(const string& cache, const struct stat& src) const {
+		CacheHeader h;
+		memset(&h, 0, sizeof h);
+		memcpy(h.magic, CACHE_MAGIC, 8);
+		h.version = CACHE_VERSION;
+		h.src_size = src.st_size;
+		h.src_mtime = src.st_mtime;
+		h.W = W; h.H = H; h.R = R; h.M = M; h.T = T; h.L = L;
+		h.NP = P.pts.size();
+		
+		const string tmp = cache + ".tmp" + to_string(getpid());
+		FILE* f = fopen(tmp.c_str(), "wb");
+		if(!f) return;
+		bool ok = fwrite(&h, sizeof h, 1, f) == 1;
+		auto put = [&](const auto& v) {
+			if(v.size() > 0) ok = ok && fwrite(v.begin(), sizeof(v[0]), v.size(), f) == v.size();
+		};
+		put(ms);
+		put(S);
+		put(P.off);
+		put(P.pts);
+		put(Len);
+		put(near_dist);
+		ok = fclose(f) == 0 && ok;
+		if(!ok || rename(tmp.c_str(), cache.c_str()) != 0) remove(tmp.c_str());
+	}
+};
+
+// ==================== Search Queue ====================
+struct SearchNode {
+	Point p;
+	int id, l, depth;
+};
+
+// Monotone bucket queue (Dial) keyed by small integer costs. Within a bucket
+// the deepest node pops first, the same tie-break the search always used.
+// Buckets keep their capacity, so one queue serves a whole solver run.
+struct BucketQueue {
+	vector<vector<SearchNode>> buckets;
+	int lo = 0, hi = -1;  // every node lives in buckets[lo..hi]
+	size_t n = 0;
+	uint64_t pops = 0;    // over the queue's lifetime, for benchmarks
+	
+	explicit BucketQueue(int max_key): buckets(max_key + 1) {}
+	
+	static bool shallower(const SearchNode& a, const SearchNode& b) { return a.depth < b.depth; }
+	
+	inline bool empty() const { return n == 0; }
+	
+	void clear() {
+		for(int k = lo; k <= hi; ++k) buckets[k].clear();
+		lo = 0;
+		hi = -1;
+		n = 0;
+	}
+	
+	void push(int key, const SearchNode& e) {
+		if(key >= (int)buckets.size()) buckets.resize(key + 1);
+		vector<SearchNode>& b = buckets[key];
+		b.push_back(e);
+		push_heap(b.begin(), b.end(), shallower);
+		PROF_COUNT(heap_pushes, 1);
+		if(n == 0 || key < lo) lo = key;
+		if(key > hi) hi = key;
+		++ n;
+	}
+	
+	SearchNode pop() {
+		while(buckets[lo].empty()) ++ lo;
+		vector<SearchNode>& b = buckets[lo];
+		pop_heap(b.begin(), b.end(), shallower);
+		SearchNode e = b.back();
+		b.pop_back();
+		-- n;
+		++ pops;
+		PROF_COUNT(heap_pops, 1);
+		return e;
+	}
+};
+
+// Indexed min-heap of arms keyed on (path length, index), the arm the greedy
+// loop serves next on top. Each arm's heap position is kept, so one arm can be
+// removed or re-keyed after its path grew in O(log R).
+struct ArmQueue {
+	const vector<Arm>& arms;
+	vi heap, pos;  // pos[i] is -1 for arms not queued
+	
+	explicit ArmQueue(const vector<Arm>& arms): arms(arms), pos(arms.size(), -1) {}
+	
+	inline bool before(int a, int b) const {
+		const int la = arms[a].path.size(), lb = arms[b].path.size();
+		return la < lb || (la == lb && a < b);
+	}
+	
+	inline bool empty() const { return heap.empty(); }
+	inline bool contains(int i) const { return pos[i] >= 0; }
+	inline int top() const { return heap[0]; }
+	
+	void place(int k, int i) {
+		heap[k] = i;
+		pos[i] = k;
+	}
+	
+	void up(int k) {
+		const int i = heap[k];
+		for(; k > 0 && before(i, heap[(k-1) / 2]); k = (k-1) / 2) place(k, heap[(k-1) / 2]);
+		place(k, i);
+	}
+	
+	void down(int k) {
+		const int i = heap[k], n = heap.size();
+		for(int c; (c = 2*k + 1) < n; k = c) {
+			if(c + 1 < n && before(heap[c+1], heap[c])) ++ c;
+			if(!before(heap[c], i)) break;
+			place(k, heap[c]);
+		}
+		place(k, i);
+	}
+	
+	void push(int i) {
+		heap.push_back(i);
+		up(heap.size() - 1);
+	}
+	
+	void erase(int i) {
+		const int k = pos[i], last = heap.back();
+		heap.pop_back();
+		pos[i] = -1;
+		if(last == i) return;
+		place(k, last);
+		up(k);
+		down(pos[last]);
+	}
+	
+	// Re-sorts arm i after its path grew
+	void update(int i) { down(pos[i]); }
+};
+
+// Copy-on-write view of an arm used to simulate candidates without cloning it.
+// Changed cells live in a generation-stamped grid allocated once per solver run.
+struct ArmOverlay {
+	struct Cell {
+		int gen = 0;
+		char how = 'x';
+	};
+	
+	const Arm* base = nullptr;
+	ArmDelta d;
+	vector<Cell> cells;
+	int H = 0, gen = 0;
+	
+	ArmOverlay(int W, int H): cells(W * H), H(H) {}
+	
+	void reset(const Arm& a) {
+		base = &a;
+		++ gen;
+		d.keep = a.cur.size();
+		d.cur_add.clear();
+		d.cp_add.clear();
+		d.path_add.clear();
+	}
+	inline char how(const Point& p, int k) const {
+		return cells[k].gen == gen ? cells[k].how : base->how.get(p);
+	}
+	inline void set_how(const Point& p, char c) {
+		Cell& o = cells[p.x * H + p.y];
+		o.gen = gen;
+		o.how = c;
+	}
+	inline const Point& tip() const { return d.cur_add.empty() ? base->cur[d.keep-1] : d.cur_add.back(); }
+	inline size_t path_size() const { return base->path.size() + d.path_add.size(); }
+	
+	void retract() {
+		PROF_COUNT(retraction_steps, 1);
+		d.path_add += opp(d.cp_add.empty() ? base->cp[d.keep-2] : d.cp_add.back());
+		if(d.cur_add.empty()) {
+			-- d.keep;
+		} else {
+			d.cur_add.pop_back();
+			d.cp_add.pop_back();
+		}
+		set_how(tip(), 'x');
+	}
+	void extend(char c, int wait_steps) {
+		const Point p = tip() + c;
+		set_how(tip(), opp(c));
+		d.path_add.append(wait_steps, 'W');
+		d.path_add += c;
+		d.cp_add += c;
+		d.cur_add.push_back(p);
+	}
+};
+
+// Counter-based generator for per-candidate streams. Seeding is a single
+// store, unlike mt19937, so every candidate can afford its own stream.
+struct SplitMix64 {
+	typedef uint64_t result_type;
+	uint64_t s;
+	
+	explicit SplitMix64(uint64_t seed): s(seed) {}
+	static constexpr result_type min() { return 0; }
+	static constexpr result_type max() { return ~(result_type)0; }
+	
+	inline result_type operator()() {
+		uint64_t z = (s += 0x9E3779B97F4A7C15ull);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+};
+
+// Everything one worker needs to evaluate candidates, allocated once per solver run
+struct SearchScratch {
+	vector<SearchCell> cell;
+	BucketQueue Q;
+	ArmOverlay a;
+	int SS = 0;
+	// Best candidate this worker has seen in the current step, best_k is its efficiency rank
+	ArmDelta best;
+	double best_s = -1;
+	int best_k = -1;
+	
+	SearchScratch(int W, int H, int L): cell(W * H), Q(L + W + H), a(W, H) {}
+	
+	// Routes the arm's tip to waypoint pt of the task starting at task_start,
+	// extending a. rest is the Manhattan length left after pt. Fails when pt
+	// cannot be reached, or the path would run past L.
+	bool route(const GridLayout& g, const vector<Reservation>& resv, const vector<Arm>& arms,
+	           int i, int L, const Point& task_start, const Point& pt, int rest,
+	           const SolverParams& params, SplitMix64& rng) {
+		const Point& arm_start = arms[i].cur[0];
+		const Point& arm_current = arms[i].cur.back();
+		uniform_real_distribution<double> rand_dist(0.0, 1.0);
+		Q.clear();
+		const int ss = ++ SS;
+		const Point tip = a.tip();
+		const int tip_id = g.id(tip), pt_id = g.id(pt);
+		bool found = tip_id == pt_id;
+		cell[tip_id].seen = ss;
+		cell[tip_id].dist = a.path_size();
+		cell[tip_id].pred = 'x';
+		Q.push(a.path_size() + distance(tip, pt), {tip, tip_id, (int)a.path_size(), 0});
+		
+		// Direction indices into DIRS, shuffled in place
+		int vs[4] = {0, 1, 2, 3};
+		
+		// A* keyed by l plus the Manhattan distance to pt. Every move costs at
+		// least one step of the tip, so the heuristic is consistent.
+		while(!Q.empty() && !found) {
+			const auto [q, qid, l, depth] = Q.pop();
+			if(l > cell[qid].dist) continue;
+			if(l + distance(q, pt) + rest > L) break;
+			if(l >= L) continue;
+			
+			// Apply randomness parameter per iteration
+			if(rand_dist(rng) < params.bfs_randomness) {
+				shuffle(vs, vs+4, rng);
+			}
+			
+			const unsigned char nb = g.border[qid];
+			if(a.how(q, qid) != 'x' || qid == tip_id) {
+				for(int idx = 0; idx < 4; ++idx) {
+					const int d = vs[idx];
+					if(!(nb >> d & 1)) continue;
+					const int pid = qid + g.off[d];
+					const Point p = q + DIRS[d];
+					if(a.how(p, pid) != DIRS[d]) continue;
+					cell[pid].seen = ss;
+					cell[pid].dist = l+1;
+					cell[pid].pred = 'x';
+					if(pid == pt_id) { found = true; break; }
+					Q.push(l+1 + distance(p, pt), {p, pid, l+1, depth+1});
+				}
+			}
+			
+			for(int idx = 0; idx < 4; ++idx) {
+				const int d = vs[idx];
+				if(!(nb >> d & 1)) continue;
+				const int pid = qid + g.off[d];
+				const Point p = q + DIRS[d];
+				if(a.how(p, pid) != 'x') continue;
+				int l2 = l;
+				const Reservation& r = resv[pid];
+				const int j = r.owner;
+				if(j != i && r.until > l) {
+					if(r.until >= L) continue;
+					// Use ownership distance factor parameter (use cached positions)
+					if(distance(p, arm_start) > params.ownership_distance_factor * distance(p, arms[j].cur[0])) continue;
+					// Use cached task start and arm current positions
+					if(distance(task_start, arm_current) + arms[j].path.size() > distance(task_start, arms[j].cur.back()) + arms[j].path.size()) continue;
+					l2 = r.until;
+				}
+				++ l2;
+				SearchCell& s = cell[pid];
+				if(s.seen == ss && l2 >= s.dist) continue;
+				s.seen = ss;
+				s.dist = l2;
+				s.pred = DIRS[d];
+				if(pid == pt_id) { found = true; break; }
+				Q.push(l2 + distance(p, pt), {p, pid, l2, depth});
+			}
+		}
+		
+		if(!found) return false;
+		
+		// Optimize path reconstruction
+		string add;
+		add.reserve(100);  // Pre-allocate to avoid reallocations
+		Point p = pt;
+		for(int pid = pt_id; cell[pid].pred != 'x'; pid = g.id(p)) {
+			add.push_back(cell[pid].pred);
+			p += opp(cell[pid].pred);
+		}
+		while(a.tip() != p) a.retract();
+		reverse(add.begin(), add.end());
+		for(char c : add) {
+			const Point q = a.tip();
+			const Point p = q+c;
+			a.extend(c, cell[g.id(p)].dist - cell[g.id(q)].dist - 1);
+		}
+		return (int)a.path_size() <= L;
+	}
+};
+
+// One search per step from the tip of the stepping arm, shared by the first
+// waypoint of every candidate task. The ownership rule that depends on the
+// task is not applied while searching; follow() checks it on each path.
+struct FanoutSearch {
+	vector<SearchCell> cell;
+	vector<SearchCell> hit;  // state of a wanted cell when it was first relaxed, dist -1 until then
+	BucketQueue Q;
+	int SS = 0, remaining = 0;
+	
+	FanoutSearch(int W, int H, int L): cell(W * H), hit(W * H), Q(L + 1) {}
+	
+	void begin() {
+		++ SS;
+		remaining = 0;
+	}
+	void want(int id) {
+		SearchCell& h = hit[id];
+		if(h.seen == SS) return;
+		h.seen = SS;
+		h.dist = -1;
+		++ remaining;
+	}
+	inline bool reachable(int id) const { return hit[id].dist >= 0; }
+	
+	void run(const GridLayout& g, const vector<Reservation>& resv, const vector<Arm>& arms, int i, int L,
+	         const SolverParams& params, SplitMix64& rng) {
+		const Arm& a = arms[i];
+		const Point tip = a.cur.back();
+		const int tip_id = g.id(tip), l0 = a.path.size();
+		uniform_real_distribution<double> rand_dist(0.0, 1.0);
+		auto reach = [&](int pid) {
+			SearchCell& h = hit[pid];
+			if(h.seen != SS || h.dist >= 0) return;
+			h.dist = cell[pid].dist;
+			h.pred = cell[pid].pred;
+			-- remaining;
+		};
+		
+		Q.clear();
+		cell[tip_id].seen = SS;
+		cell[tip_id].dist = l0;
+		cell[tip_id].pred = 'x';
+		reach(tip_id);
+		Q.push(l0, {tip, tip_id, l0, 0});
+		int vs[4] = {0, 1, 2, 3};
+		
+		while(!Q.empty() && remaining > 0) {
+			const auto [q, qid, l, depth] = Q.pop();
+			if(l > cell[qid].dist) continue;
+			if(l >= L) break;
+			
+			if(rand_dist(rng) < params.bfs_randomness) {
+				shuffle(vs, vs+4, rng);
+			}
+			
+			const unsigned char nb = g.border[qid];
+			if(a.how.get(q) != 'x' || qid == tip_id) {
+				for(int idx = 0; idx < 4; ++idx) {
+					const int d = vs[idx];
+					if(!(nb >> d & 1)) continue;
+					const int pid = qid + g.off[d];
+					const Point p = q + DIRS[d];
+					if(a.how.get(p) != DIRS[d]) continue;
+					cell[pid].seen = SS;
+					cell[pid].dist = l+1;
+					cell[pid].pred = 'x';
+					reach(pid);
+					Q.push(l+1, {p, pid, l+1, depth+1});
+				}
+			}
+			
+			for(int idx = 0; idx < 4; ++idx) {
+				const int d = vs[idx];
+				if(!(nb >> d & 1)) continue;
+				const int pid = qid + g.off[d];
+				const Point p = q + DIRS[d];
+				if(a.how.get(p) != 'x') continue;
+				int l2 = l;
+				const Reservation& r = resv[pid];
+				const int j = r.owner;
+				if(j != i && r.until > l) {
+					if(r.until >= L) continue;
+					if(distance(p, a.cur[0]) > params.ownership_distance_factor * distance(p, arms[j].cur[0])) continue;
+					l2 = r.until;
+				}
+				++ l2;
+				SearchCell& s = cell[pid];
+				if(s.seen == SS && l2 >= s.dist) continue;
+				s.seen = SS;
+				s.dist = l2;
+				s.pred = DIRS[d];
+				reach(pid);
+				Q.push(l2, {p, pid, l2, depth});
+			}
+		}
+	}
+	
+	// Replays the path to pt onto the overlay. Fails, leaving the overlay
+	// untouched, when the path waits behind an arm whose tip is closer to pt,
+	// which the per-task search would not have allowed.
+	bool follow(ArmOverlay& a, const GridLayout& g, const vector<Reservation>& resv,
+	            const vector<Arm>& arms, int i, const Point& pt) const {
+		const int pt_id = g.id(pt);
+		const int own = distance(pt, arms[i].cur.back());
+		string add;
+		Point p = pt;
+		for(int pid = pt_id; ; ) {
+			const SearchCell& c = pid == pt_id ? hit[pid] : cell[pid];
+			if(c.pred == 'x') break;
+			add.push_back(c.pred);
+			p += opp(c.pred);
+			const int qid = g.id(p);
+			const Reservation& r = resv[pid];
+			if(r.owner != i && r.until > cell[qid].dist && own > distance(pt, arms[r.owner].cur.back())) return false;
+			pid = qid;
+		}
+		
+		while(a.tip() != p) a.retract();
+		reverse(add.begin(), add.end());
+		int dq = cell[g.id(p)].dist;
+		for(char c : add) {
+			const int nid = g.id(a.tip() + c);
+			const int dp = nid == pt_id ? hit[pt_id].dist : cell[nid].dist;
+			a.extend(c, dp - dq - 1);
+			dq = dp;
+		}
+		return true;
+	}
+};
+
+// Last evaluation of one task for one arm. The box covers every cell the
+// candidate's path visits, or for a failed task every cell a path could still
+// use within the remaining budget. A commit touching the box marks it dirty,
+// and a dirty entry is ranked by its upper bound until evaluated again.
+struct Candidate {
+	double s;    // S[t] / path_diff, -1 when the task could not be routed
+	int t, rank; // rank breaks ties in favour of the more efficient task
+	Box box;
+	int step;    // step it was evaluated in
+	bool dirty;
+	double ub;   // S[t] over the Manhattan length of the task from the arm tip
+	
+	bool operator<(const Candidate& o) const { return s != o.s ? s < o.s : rank > o.rank; }
+};
+
+// ==================== Thread Pool ====================
+// Fixed set of workers that pull loop indices from a shared atomic counter, so
+// a worker that finishes early keeps taking candidates until the range is empty.
+class ThreadPool {
+	vector<thread> threads;
+	mutex m;
+	condition_variable start_cv, done_cv;
+	const function<void(int, int)>* job = nullptr;
+	int job_n = 0, generation = 0, busy = 0;
+	atomic<int> next{0};
+	bool stop = false;
+	
+	void drain(int w) {
+		for(int k; (k = next.fetch_add(1, memory_order_relaxed)) < job_n; ) (*job)(w, k);
+	}
+	
+	void loop(int w) {
+		int seen = 0;
+		while(true) {
+			unique_lock<mutex> lk(m);
+			start_cv.wait(lk, [&] { return stop || generation != seen; });
+			if(stop) return;
+			seen = generation;
+			lk.unlock();
+			drain(w);
+			lk.lock();
+			if(-- busy == 0) done_cv.notify_one();
+		}
+	}
+
+public:
+	explicit ThreadPool(int n) {
+		for(int w = 1; w < n; ++w) threads.emplace_back(&ThreadPool::loop, this, w);
+	}
+	
+	~ThreadPool() {
+		{
+			lock_guard<mutex> lk(m);
+			stop = true;
+		}
+		start_cv.notify_all();
+		for(thread& t : threads) t.join();
+	}
+	
+	int size() const { return threads.size() + 1; }
+	
+	// Runs fn(worker, k) for every k in [0, n); the caller takes part as worker 0
+	void parallel_for(int n, const function<void(int, int)>& fn) {
+		if(threads.empty() || n <= 1) {
+			for(int k = 0; k < n; ++k) fn(0, k);
+			return;
+		}
+		{
+			lock_guard<mutex> lk(m);
+			job = &fn;
+			job_n = n;
+			next = 0;
+			busy = threads.size();
+			++ generation;
+		}
+		start_cv.notify_all();
+		drain(0);
+		unique_lock<mutex> lk(m);
+		done_cv.wait(lk, [&] { return busy == 0; });
+	}
+};
+
+void parallel_for(ThreadPool* pool, int n, const function<void(int, int)>& fn) {
+	if(pool) pool->parallel_for(n, fn);
+	else for(int k = 0; k < n; ++k) fn(0, k);
+}
+
+// ==================== Solver ====================
+// Everything a greedy run builds, kept so that a finished solution can be
+// partly undone and continued. log holds every change to the arms in order.
+struct SolverState {
+	struct Commit {
+		int arm, task;  // task -1: the arm retracted to its mount
+		ArmDelta delta;
+	};
+	
+	vector<Point> ms;  // mount order of the run, arm i sits on ms[i]
+	vector<Arm> arms;
+	vector<Reservation> resv;
+	vi keep;           // tasks that passed the KEEP filter, most efficient first
+	vi rank;           // position in keep, -1 for dropped tasks
+	vi ts;             // kept tasks not committed yet
+	vector<Commit> log;
+	int score = 0;
+	uint64_t pops = 0;  // search queue pops of all greedy runs on this state
+};
+
+// Arms back on their mounts with nothing committed
+void reset_state(const Instance& in, SolverState& st) {
+	const GridLayout g(in.W, in.H);
+	st.resv.assign(in.W * in.H, Reservation());
+	st.arms.clear();
+	st.arms.reserve(in.R);  // Pre-allocate to avoid reallocations
+	for(int i = 0; i < in.M; ++i) {
+		st.resv[g.id(st.ms[i])].owner = i;
+		st.resv[g.id(st.ms[i])].until = in.L;
+		if(i < in.R) st.arms.push_back(Arm(st.ms[i].x, st.ms[i].y, i));
 	}
+	st.ts = st.keep;
+	st.log.clear();
+	st.score = 0;
+}
+
+// Params-dependent setup: task order, KEEP filter and mount order
+void init_state(const Instance& in, const SolverParams& params, mt19937& mt, bool verbose, SolverState& st) {
+	PROF_TIMER(preprocess_ns);
+	const int W = in.W, R = in.R, T = in.T, L = in.L;
+	vi ts(T); iota(ts.begin(), ts.end(), 0);
+	
+	// Task length with the distance penalty for reaching its start
+	vi Len(T);
+	for(int i = 0; i < T; ++i) Len[i] = in.Len[i] + (int)(in.near_dist[i] * params.distance_penalty);
 	
 	// Sort by efficiency with weight parameter (cache pow calculations)
 	vector<double> efficiency_scores(T);
 	for(int i = 0; i < T; ++i) {
-		efficiency_scores[i] = pow(S[i], params.task_efficiency_weight) / (Len[i] + 1);
+		efficiency_scores[i] = pow(in.S[i], params.task_efficiency_weight) / (Len[i] + 1);
 	}
 	sort(ts.begin(), ts.end(), [&](int i, int j) { 
 		return efficiency_scores[i] > efficiency_scores[j];
@@ -199,319 +1356,1271 @@ int greedy_solver(int W, int H, int R, int M, int T, int L,
 	}
 	if(verbose) cerr << "KEEP: " << j << " / " << ts.size() << endl;
 	ts.resize(j);
+	st.keep = ts;
+	st.rank.assign(T, -1);
+	for(int k = 0; k < (int)ts.size(); ++k) st.rank[ts[k]] = k;
 	
-	// Sort mounting points (optimize min calculation)
-	if(W == 300) {
-		vi ms_dist(M);
-		for(int i = 0; i < M; ++i) {
-			ms_dist[i] = min({ms[i].x, W-1-ms[i].x, ms[i].y, H-1-ms[i].y});
-		}
-		vi ms_indices(M);
-		iota(ms_indices.begin(), ms_indices.end(), 0);
-		sort(ms_indices.begin(), ms_indices.end(), [&](int i, int j) {
-			return ms_dist[i] < ms_dist[j];
-		});
-		vector<Point> ms_sorted(M);
-		for(int i = 0; i < M; ++i) {
-			ms_sorted[i] = ms[ms_indices[i]];
+	// Mount order: border mounts first on the 300x300 map, shuffled otherwise
+	st.ms = W == 300 ? in.ms_by_border : vector<Point>(in.ms.begin(), in.ms.end());
+	if(W != 300) shuffle(st.ms.begin(), st.ms.end(), mt);
+	
+	reset_state(in, st);
+}
+
+// Applies one logged change and updates the reservations the way the search
+// expects them. With check set, a move into a cell another arm still holds
+// fails the commit, leaving the state half-applied.
+bool apply_commit(const Instance& in, const GridLayout& g, SolverState& st,
+                  const SolverState::Commit& c, Box& changed, bool check) {
+	const int i = c.arm, L = in.L;
+	Arm& a = st.arms[i];
+	vector<Reservation>& resv = st.resv;
+	
+	if(c.task < 0) {
+		while(a.cur.size() > 1 && (int)a.path.size() < L) {
+			PROF_COUNT(retraction_steps, 1);
+			Point p = a.cur.back();
+			changed.add(p);
+			resv[g.id(p)].until = a.path.size();
+			a.path.push_back(opp(a.cp.back()));
+			a.cur.pop_back();
+			a.cp.pop_back();
+			a.how.set(a.cur.back(), 'x');
 		}
-		ms = move(ms_sorted);
-	} else {
-		shuffle(ms.begin(), ms.end(), mt);
+		return true;
+	}
+	
+	Point p = a.cur.back();
+	const int l_old = a.path.size();
+	c.delta.apply(a);
+	changed.add(p);
+	bool ok = true;
+	c.delta.path_add.each(l_old, [&](int l, char m) {
+		if(m == 'W' || !ok) return;
+		if(a.how.get(p) == 'x' && p != a.cur.back()) resv[g.id(p)].until = l;
+		p += m;
+		changed.add(p);
+		Reservation& r = resv[g.id(p)];
+		if(check && r.owner != i && r.until > l) ok = false;
+		r.owner = i;
+		r.until = L;
+	});
+	if(!ok) return false;
+	a.z.push_back(c.task);
+	st.score += in.S[c.task];
+	return true;
+}
+
+// Rebuilds the state from the mounts by replaying log. Returns the index of
+// the first change that no longer fits, -1 when all do. A change stops fitting
+// when an arm's later changes were dropped and other arms afterwards used the
+// cells it now keeps.
+int replay(const Instance& in, SolverState& st, const vector<SolverState::Commit>& log) {
+	const GridLayout g(in.W, in.H);
+	reset_state(in, st);
+	vector<char> done(in.T, 0);
+	for(size_t k = 0; k < log.size(); ++k) {
+		const SolverState::Commit& c = log[k];
+		Box changed;
+		if(!apply_commit(in, g, st, c, changed, true)) return k;
+		st.log.push_back(c);
+		if(c.task >= 0) done[c.task] = 1;
 	}
+	st.ts.clear();
+	for(int t : st.keep) if(!done[t]) st.ts.push_back(t);
+	return -1;
+}
+
+// Result of a greedy run given up because it could not beat its abort threshold
+const int ABORTED = -1;
+
+// Greedy insertion from the current state until no arm can take another task.
+// With abort_at set, returns ABORTED as soon as the final score is bound to
+// stay at or below it, leaving the state half-built.
+int greedy_run(const Instance& in, SolverState& st, const SolverParams& params,
+               mt19937& mt, bool verbose, ThreadPool* pool = nullptr, double abort_at = -1) {
+	
+	const int W = in.W, H = in.H, R = in.R, T = in.T, L = in.L;
+	const View<int>& S = in.S;
+	const Waypoints& P = in.P;
+	const View<int>& raw = in.Len;
+	const vector<Box>& task_box = in.task_box;
+	
+	GridLayout g(W, H);
+	vector<Arm>& arms = st.arms;
+	vector<Reservation>& resv = st.resv;
+	vi& ts = st.ts;
+	const vi& order = st.keep;
+	const vi& rank = st.rank;
+	for(Arm& a : arms) a.done = false;
+	
+	// Arms waiting for a step. An arm that found nothing is parked until the
+	// next change to any arm, which gives it another try unless its time is up.
+	ArmQueue queue(arms);
+	for(int i = 0; i < R; ++i) queue.push(i);
+	vi parked;
+	auto park = [&](int i) {
+		arms[i].done = true;
+		queue.erase(i);
+		parked.push_back(i);
+	};
+	auto unpark = [&]() {
+		for(int j : parked) if((int)arms[j].path.size() < L) {
+			arms[j].done = false;
+			queue.push(j);
+		}
+		parked.clear();
+	};
+	
+	// One scratch set per worker so candidates can be searched concurrently
+	const int workers = pool ? pool->size() : 1;
+	vector<SearchScratch> scratch;
+	scratch.reserve(workers);
+	for(int w = 0; w < workers; ++w) scratch.emplace_back(W, H, L);
+	FanoutSearch fan(W, H, L);
+	auto count_pops = [&]() {
+		st.pops += fan.Q.pops;
+		for(const SearchScratch& sc : scratch) st.pops += sc.Q.pops;
+	};
 	
-	arms.clear();
-	arms.reserve(R);  // Pre-allocate to avoid reallocations
-	for(int i = 0; i < M; ++i) {
-		owner[ms[i].x][ms[i].y] = i;
-		until[ms[i].x][ms[i].y] = L;
-		if(i < R) arms.push_back(Arm(W, H, ms[i].x, ms[i].y, i));
+	// Candidate cache: a lazy max-heap per arm, rebuilt when the arm itself moves
+	vector<vector<Candidate>> cache(R);
+	vector<char> cache_ok(R, 0), taken(T, 1);
+	vi ts_pos(T, -1);  // position of each open task in ts
+	for(size_t k = 0; k < ts.size(); ++k) {
+		taken[ts[k]] = 0;
+		ts_pos[ts[k]] = k;
 	}
+	vi batch, near;
+	vector<Candidate> res;
 	
-	vector<vi> seen(W, vi(H, 0));
-	vector<vi> dist(W, vi(H, 0));
-	vector<string> pred(W, string(H, 'x'));
-	int SS = 0;
+	// With candidate_k set, a heap only holds the tasks starting nearest to the tip
+	const int K = params.candidate_k;
+	SpatialIndex starts(W, H, K > 0 ? ts.size() : 0);
+	if(K > 0) for(int t : ts) starts.insert(P[t][0], t);
+	
+	// Tasks each arm can still fit: L - len - |tip P[t][0]| - raw[t] >= 0. The
+	// tip never gets further from where it was than the path grew meanwhile, so
+	// this slack only shrinks and a task that fails it is gone for that arm.
+	vector<vi> feasible(K > 0 ? 0 : R, ts);
+	auto fits = [&](int t, int l0, const Point& tip) {
+		return l0 + distance(tip, P[t][0]) + raw[t] <= L;
+	};
+	const int chunk = max(16, 4 * workers);
+	int step = 0;
 	
-	// Pre-create random distribution outside hot loop
-	uniform_real_distribution<double> rand_dist(0.0, 1.0);
+	// Upper bound on the final score: a fractional knapsack of the open tasks
+	// into the time the arms have left, each task weighing its Manhattan length
+	// at least. Commits weigh no less than that and the time left only shrinks,
+	// so the bound never goes up.
+	vi by_density;
+	if(abort_at >= 0) {
+		by_density = ts;
+		sort(by_density.begin(), by_density.end(), [&](int a, int b) {
+			return (long long)S[a] * raw[b] > (long long)S[b] * raw[a];
+		});
+	}
+	auto bound = [&]() {
+		long long left = 0;
+		int longest = 0;
+		for(const Arm& a : arms) {
+			left += L - a.path.size();
+			longest = max(longest, L - (int)a.path.size());
+		}
+		double ub = st.score;
+		for(int t : by_density) {
+			if(taken[t] || raw[t] > longest) continue;
+			if(raw[t] > left) return ub + (double)S[t] * left / raw[t];
+			ub += S[t];
+			left -= raw[t];
+		}
+		return ub;
+	};
 	
-	// Pre-allocate direction string
-	const char dirs[4] = {'R', 'L', 'U', 'D'};
+	// Marks the cached candidates of other arms whose box the change touches
+	auto touch = [&](int i, const Box& b) {
+		for(int k = 0; k < R; ++k) {
+			if(k == i || !cache_ok[k]) continue;
+			bool reheap = false;
+			for(Candidate& c : cache[k]) {
+				if(c.dirty || !c.box.overlaps(b)) continue;
+				c.dirty = true;
+				c.s = c.ub;
+				reheap = true;
+			}
+			if(reheap) make_heap(cache[k].begin(), cache[k].end());
+		}
+	};
 	
 	while(true) {
-		int i = -1;
-		for(int i0 = 0; i0 < R; ++i0)
-			if(!arms[i0].done && (i == -1 || arms[i0].path.size() < arms[i].path.size()))
-				i = i0;
-		if(i == -1) break;
+		if(abort_at >= 0 && bound() <= abort_at) {
+			count_pops();
+			return ABORTED;
+		}
+		
+		if(queue.empty()) break;
+		const int i = queue.top();
 		
 		const int l0 = arms[i].path.size();
 		if(verbose) cerr << "I " << i << ' ' << l0 << endl;
 		
-		Arm bestA;
-		int bestT = -1;
-		double bestS = -1;
-		
-		// Cache arm[i] positions to avoid repeated access
-		const Point& arm_start = arms[i].cur[0];
+		// Cache arm[i] tip to avoid repeated access
 		const Point& arm_current = arms[i].cur.back();
-		const size_t arm_path_size = arms[i].path.size();
-		
-		for(int t : ts) {
-			bool bad = false;
-			// Use reference to avoid expensive copy - we'll copy only if needed
-			const Arm& arm_ref = arms[i];
-			Arm a = arm_ref;  // Still need copy for path simulation
-			// Pre-reserve space to reduce reallocations
-			a.path.reserve(L);
-			a.cp.reserve(L);
-			a.cur.reserve(100);
+		
+		// Every candidate draws from its own stream derived from the step seed, so
+		// the outcome does not depend on how candidates are spread over workers
+		const uint64_t step_seed = (uint64_t)mt() << 32;
+		for(SearchScratch& sc : scratch) sc.best_k = -1;
+		++ step;
+		
+		PROF_TIMER(search_ns);
+		vector<Candidate>& heap = cache[i];
+		if(!cache_ok[i]) {
+			heap.clear();
+			vi& open = K > 0 ? near : feasible[i];
+			if(K > 0) starts.nearest_k(arm_current, K, near);
+			size_t n = 0;
+			for(int t : open) {
+				if(taken[t] || !fits(t, l0, arm_current)) continue;
+				open[n++] = t;
+				// path_diff covers at least the Manhattan length from the tip through P[t]
+				const double ub = (double)S[t] / max(1, distance(arm_current, P[t][0]) + raw[t]);
+				heap.push_back({ub, t, rank[t], Box(), 0, true, ub});
+			}
+			open.resize(n);
+			make_heap(heap.begin(), heap.end());
+			cache_ok[i] = true;
+		}
+		
+		// Evaluate chunks from the top of the heap, each ending at the first clean
+		// entry, until an entry from this step or a clean failure is on top. Dirty
+		// entries rank by upper bound, so those that cannot beat it are never searched.
+		for(int round = 0; ; ++round) {
+			batch.clear();
+			while(!heap.empty() && (int)batch.size() < chunk) {
+				const Candidate& c = heap.front();
+				const int t = c.t;
+				const bool dirty = c.dirty;
+				if(!taken[t] && (c.step == step || (!dirty && c.s < 0))) break;
+				pop_heap(heap.begin(), heap.end());
+				heap.pop_back();
+				if(taken[t]) continue;
+				batch.push_back(t);
+				if(!dirty) break;
+			}
+			if(batch.empty()) break;
 			
-			for(const Point &pt : P[t]) {
-				typedef tuple<Point, int, int> QEl;
-				const auto comp = [](const QEl &a, const QEl &b) {
-					return get<1>(a) > get<1>(b) || (get<1>(a) == get<1>(b) && get<2>(a) < get<2>(b));
-				};
-				priority_queue<QEl, vector<QEl>, decltype(comp)> Q(comp);
-				++ SS;
-				bool found = a.cur.back() == pt;
-				seen[a.cur.back().x][a.cur.back().y] = SS;
-				dist[a.cur.back().x][a.cur.back().y] = a.path.size();
-				pred[a.cur.back().x][a.cur.back().y] = 'x';
-				Q.emplace(a.cur.back(), a.path.size(), 0);
+			// The first waypoints of all candidates come out of one search from the tip
+			fan.begin();
+			for(int t : batch) fan.want(g.id(P[t][0]));
+			SplitMix64 fan_rng(step_seed | (0xFFFFFFFFu - round));
+			fan.run(g, resv, arms, i, L, params, fan_rng);
+			
+			res.resize(batch.size());
+			parallel_for(pool, batch.size(), [&](int w, int k) {
+				const int t = batch[k];
+				SearchScratch& sc = scratch[w];
+				ArmOverlay& a = sc.a;
+				SplitMix64 rng(step_seed | (uint32_t)t);
+				bool bad = false;
+				a.reset(arms[i]);
+				
+				// Unless routed below, the task is failed with a box of every cell a path within budget could use
+				Candidate& c = res[k];
+				const double ub = (double)S[t] / max(1, distance(arm_current, P[t][0]) + raw[t]);
+				c = {-1, t, rank[t], task_box[t], step, false, ub};
+				c.box.add(arm_current);
+				const int slack = L - l0 - distance(arm_current, P[t][0]) - raw[t];
+				if(slack < 0) c.box = Box();
+				c.box.grow(slack);
+				
+				if(!fan.reachable(g.id(P[t][0]))) return;
+				
+				// Only the later waypoints are searched per task, plus the first one
+				// when its shared path waits behind an arm this task must not wait for
+				const size_t first = fan.follow(a, g, resv, arms, i, P[t][0]) ? 1 : 0;
+				if((int)a.path_size() > L) return;
+				
+				int rest = raw[t];  // Manhattan length from the current waypoint to the last
+				for(size_t n = first; n < P[t].size() && !bad; ++n) {
+					if(n > 0) rest -= distance(P[t][n-1], P[t][n]);
+					bad = !sc.route(g, resv, arms, i, L, P[t][0], P[t][n], rest, params, rng);
+				}
+				
+				if(bad) return;
 				
-				// Pre-allocate direction array
-				char vs[4] = {'R', 'L', 'U', 'D'};
+				int path_diff = a.d.path_add.size();
+				if(path_diff <= 0) return;
 				
-				while(!Q.empty() && !found) {
-					auto [q, l, depth] = Q.top(); Q.pop();
-					if(l > dist[q.x][q.y]) continue;
-					if(l >= L) break;
+				double score_t = (double)S[t] / path_diff;
+				c.s = score_t;
+				c.box = Box();
+				Point p = arm_current;
+				c.box.add(p);
+				a.d.path_add.each(0, [&](int, char m) { if(m != 'W') c.box.add(p += m); });
+				
+				if(sc.best_k == -1 || score_t > sc.best_s || (score_t == sc.best_s && rank[t] < sc.best_k)) {
+					swap(sc.best, a.d);
+					sc.best_s = score_t;
+					sc.best_k = rank[t];
+				}
+			});
+			
+			PROF_COUNT(candidates, res.size());
+			for(const Candidate& c : res) {
+				if(c.s < 0) PROF_COUNT(failed_candidates, 1);
+				heap.push_back(c);
+				push_heap(heap.begin(), heap.end());
+			}
+		}
+		
+		// Deterministic reduction: highest score, best efficiency rank on ties
+		int best_w = -1;
+		for(int w = 0; w < workers; ++w) {
+			const SearchScratch& sc = scratch[w];
+			if(sc.best_k == -1) continue;
+			if(best_w == -1 || sc.best_s > scratch[best_w].best_s ||
+			   (sc.best_s == scratch[best_w].best_s && sc.best_k < scratch[best_w].best_k)) best_w = w;
+		}
+		const int bestT = best_w == -1 ? -1 : order[scratch[best_w].best_k];
+		PROF_STOP(search_ns);
+		PROF_TIMER(commit_ns);
+		
+		if(bestT == -1) {
+			if(arms[i].cur.size() <= 1) {
+				park(i);
+				continue;
+			}
+			Box changed;
+			st.log.push_back({i, -1, ArmDelta()});
+			apply_commit(in, g, st, st.log.back(), changed, false);
+			cache_ok[i] = false;
+			touch(i, changed);
+			queue.update(i);
+			unpark();
+			park(i);
+			continue;
+		}
+		
+		Box changed;
+		st.log.push_back({i, bestT, move(scratch[best_w].best)});
+		apply_commit(in, g, st, st.log.back(), changed, false);
+		cache_ok[i] = false;
+		touch(i, changed);
+		queue.update(i);
+		unpark();
+		taken[bestT] = 1;
+		if(K > 0) starts.erase(P[bestT][0], bestT);
+		
+		const int ind = ts_pos[bestT];
+		ts_pos[ts.back()] = ind;
+		swap(ts[ind], ts.back());
+		ts.pop_back();
+		if(verbose) cerr << st.score << '\n';
+	}
+	
+	if(verbose) {
+		cerr << "restant: " << ts.size() << endl;
+		cerr << st.score << '\n';
+	}
+	
+	count_pops();
+	return st.score;
+}
+
+int greedy_solver(const Instance& in, vector<Arm>& arms, const SolverParams& params,
+                  mt19937& mt, bool verbose, ThreadPool* pool = nullptr, double abort_at = -1) {
+	SolverState st;
+	init_state(in, params, mt, verbose, st);
+	const int score = greedy_run(in, st, params, mt, verbose, pool, abort_at);
+	arms = move(st.arms);
+	return score;
+}
+
+// ==================== Trace ====================
+// JSONL record of every evaluation a search makes. Records collect in memory
+// and a background thread writes them out in large blocks, so the search only
+// pays for formatting a line and taking a lock.
+class TraceWriter {
+	FILE* f = nullptr;
+	mutex m;
+	condition_variable cv;
+	string pending;  // records not yet handed to the writer thread
+	bool stop = false;
+	thread writer;
+	static const size_t BLOCK = 1 << 16;
+	
+	void loop() {
+		string out;
+		unique_lock<mutex> lk(m);
+		while(true) {
+			cv.wait_for(lk, chrono::milliseconds(500), [&] { return stop || pending.size() >= BLOCK; });
+			out.swap(pending);
+			const bool last = stop;
+			lk.unlock();
+			if(!out.empty()) {
+				fwrite(out.data(), 1, out.size(), f);
+				fflush(f);
+				out.clear();
+			}
+			if(last) return;
+			lk.lock();
+		}
+	}
+
+public:
+	explicit TraceWriter(const string& file): f(fopen(file.c_str(), "w")) {
+		if(f) writer = thread(&TraceWriter::loop, this);
+	}
+	
+	~TraceWriter() {
+		if(!f) return;
+		{
+			lock_guard<mutex> lk(m);
+			stop = true;
+		}
+		cv.notify_one();
+		writer.join();
+		fclose(f);
+	}
+	
+	bool ok() const { return f != nullptr; }
+	
+	// One evaluation: it counts from 1 per chain, ns since the search started,
+	// a negative temperature is left out and an ABORTED score is written as null
+	void evaluation(int it, int chain, int64_t ns, const SolverParams& p, int score,
+	                bool accepted, bool best, double temperature = -1) {
+		char buf[320];
+		int n = snprintf(buf, sizeof buf,
+		                 "{\"it\":%d,\"chain\":%d,\"ns\":%lld,\"params\":[%.6g,%.6g,%.6g,%.6g,%.6g],\"score\":",
+		                 it, chain, (long long)ns, p.task_efficiency_weight, p.distance_penalty,
+		                 p.ownership_distance_factor, p.path_cost_threshold, p.bfs_randomness);
+		n += score == ABORTED ? snprintf(buf + n, sizeof buf - n, "null")
+		                      : snprintf(buf + n, sizeof buf - n, "%d", score);
+		n += snprintf(buf + n, sizeof buf - n, ",\"accepted\":%s,\"best\":%s",
+		              accepted ? "true" : "false", best ? "true" : "false");
+		if(temperature >= 0) n += snprintf(buf + n, sizeof buf - n, ",\"temp\":%.4f", temperature);
+		n += snprintf(buf + n, sizeof buf - n, "}\n");
+		
+		lock_guard<mutex> lk(m);
+		pending.append(buf, n);
+		if(pending.size() >= BLOCK) cv.notify_one();
+	}
+};
+
+// ==================== Tuners ====================
+// The tunable params as a point of the unit cube, one coordinate per param
+// that is not fixed. Fixed params keep the value of the base params.
+struct ParamSpace {
+	static constexpr double SolverParams::* field[5] = {
+		&SolverParams::task_efficiency_weight, &SolverParams::distance_penalty,
+		&SolverParams::ownership_distance_factor, &SolverParams::path_cost_threshold,
+		&SolverParams::bfs_randomness};
+	static constexpr double lo[5] = {0.1, 0.5, 1.0, 0.5, 0.0};
+	static constexpr double hi[5] = {3.0, 2.0, 5.0, 2.0, 1.0};
+	
+	SolverParams base;
+	vi free;  // indices into field
+	
+	ParamSpace(const SolverParams& base, const ParamFixFlags& fix): base(base) {
+		const bool fixed[5] = {fix.fix_task_eff, fix.fix_dist_penalty, fix.fix_ownership,
+		                       fix.fix_path_threshold, fix.fix_bfs_random};
+		for(int k = 0; k < 5; ++k) if(!fixed[k]) free.push_back(k);
+	}
+	
+	int dim() const { return free.size(); }
+	
+	vector<double> encode(const SolverParams& p) const {
+		vector<double> x;
+		for(int k : free) x.push_back(max(0.0, min(1.0, (p.*field[k] - lo[k]) / (hi[k] - lo[k]))));
+		return x;
+	}
+	
+	// Coordinates outside the cube are clamped onto it
+	SolverParams decode(const vector<double>& x) const {
+		SolverParams p = base;
+		for(int j = 0; j < dim(); ++j) {
+			const int k = free[j];
+			p.*field[k] = lo[k] + max(0.0, min(1.0, x[j])) * (hi[k] - lo[k]);
+		}
+		return p;
+	}
+	
+	SolverParams sample(mt19937& mt) const {
+		uniform_real_distribution<double> u(0.0, 1.0);
+		vector<double> x(dim());
+		for(double& v : x) v = u(mt);
+		return decode(x);
+	}
+};
+
+// One evaluation request: params scored as the mean greedy score over the
+// seeds [seed, seed + seeds)
+struct Trial {
+	SolverParams params;
+	int seed, seeds;
+	double score;
+};
+
+// Ask/tell interface of the parameter tuners. ask() returns the next batch
+// to evaluate, empty when the tuner has nothing left to try; tell() gets the
+// same batch back with the scores filled in.
+class Tuner {
+public:
+	virtual ~Tuner() {}
+	virtual vector<Trial> ask() = 0;
+	virtual void tell(const vector<Trial>& batch) = 0;
+};
+
+// Eigen decomposition of a small symmetric matrix by cyclic Jacobi rotations:
+// A = V diag(e) V^T, the eigenvectors in the columns of V
+void jacobi_eigen(vector<vector<double>> A, vector<vector<double>>& V, vector<double>& e) {
+	const int n = A.size();
+	V.assign(n, vector<double>(n, 0.0));
+	for(int i = 0; i < n; ++i) V[i][i] = 1.0;
+	for(int sweep = 0; sweep < 50; ++sweep) {
+		double off = 0;
+		for(int p = 0; p < n; ++p) for(int q = p+1; q < n; ++q) off += A[p][q] * A[p][q];
+		if(off < 1e-30) break;
+		for(int p = 0; p < n; ++p) for(int q = p+1; q < n; ++q) {
+			if(fabs(A[p][q]) < 1e-300) continue;
+			const double theta = (A[q][q] - A[p][p]) / (2 * A[p][q]);
+			const double t = (theta >= 0 ? 1 : -1) / (fabs(theta) + sqrt(theta * theta + 1));
+			const double c = 1 / sqrt(t * t + 1), s = t * c;
+			for(int k = 0; k < n; ++k) {
+				const double akp = A[k][p], akq = A[k][q];
+				A[k][p] = c * akp - s * akq;
+				A[k][q] = s * akp + c * akq;
+			}
+			for(int k = 0; k < n; ++k) {
+				const double apk = A[p][k], aqk = A[q][k];
+				A[p][k] = c * apk - s * aqk;
+				A[q][k] = s * apk + c * aqk;
+			}
+			for(int k = 0; k < n; ++k) {
+				const double vkp = V[k][p], vkq = V[k][q];
+				V[k][p] = c * vkp - s * vkq;
+				V[k][q] = s * vkp + c * vkq;
+			}
+		}
+	}
+	e.resize(n);
+	for(int i = 0; i < n; ++i) e[i] = A[i][i];
+}
+
+// CMA-ES over the free params in the unit cube, maximising. Each generation
+// shares one seed, so its members are ranked on the same random stream.
+class CmaesTuner : public Tuner {
+	ParamSpace space;
+	mt19937 mt;
+	int n, lambda, mu, gen = 0, base_seed;
+	vector<double> w;
+	double mueff, cc, cs, c1, cmu, damps, chiN, sigma = 0.3;
+	vector<double> m, pc, ps, D;
+	vector<vector<double>> C, B, xs;
+
+public:
+	CmaesTuner(const ParamSpace& space, const SolverParams& start, int base_seed):
+		space(space), mt(base_seed), n(space.dim()), base_seed(base_seed) {
+		lambda = 4 + (int)(3 * log(max(1, n)));
+		mu = lambda / 2;
+		for(int i = 0; i < mu; ++i) w.push_back(log(mu + 0.5) - log(i + 1));
+		const double sw = accumulate(w.begin(), w.end(), 0.0);
+		double sw2 = 0;
+		for(double& v : w) {
+			v /= sw;
+			sw2 += v * v;
+		}
+		mueff = 1 / sw2;
+		cc = (4 + mueff / n) / (n + 4 + 2 * mueff / n);
+		cs = (mueff + 2) / (n + mueff + 5);
+		c1 = 2 / ((n + 1.3) * (n + 1.3) + mueff);
+		cmu = min(1 - c1, 2 * (mueff - 2 + 1 / mueff) / ((n + 2) * (n + 2) + mueff));
+		damps = 1 + 2 * max(0.0, sqrt((mueff - 1) / (n + 1)) - 1) + cs;
+		chiN = sqrt(n) * (1 - 1.0 / (4 * n) + 1.0 / (21 * n * n));
+		m = space.encode(start);
+		pc.assign(n, 0.0);
+		ps.assign(n, 0.0);
+		D.assign(n, 1.0);
+		C.assign(n, vector<double>(n, 0.0));
+		B = C;
+		for(int i = 0; i < n; ++i) C[i][i] = B[i][i] = 1.0;
+	}
+	
+	vector<Trial> ask() override {
+		if(n == 0) return {};
+		normal_distribution<double> N(0.0, 1.0);
+		vector<Trial> batch;
+		xs.assign(lambda, vector<double>(n));
+		for(int k = 0; k < lambda; ++k) {
+			vector<double> z(n);
+			for(double& v : z) v = N(mt);
+			for(int i = 0; i < n; ++i) {
+				double y = 0;
+				for(int j = 0; j < n; ++j) y += B[i][j] * D[j] * z[j];
+				xs[k][i] = m[i] + sigma * y;
+			}
+			batch.push_back({space.decode(xs[k]), base_seed + 1 + gen, 1, 0.0});
+		}
+		return batch;
+	}
+	
+	void tell(const vector<Trial>& batch) override {
+		vi order(lambda);
+		iota(order.begin(), order.end(), 0);
+		stable_sort(order.begin(), order.end(), [&](int a, int b) { return batch[a].score > batch[b].score; });
+		
+		const vector<double> old = m;
+		vector<double> yw(n, 0.0);
+		for(int i = 0; i < n; ++i) {
+			m[i] = 0;
+			for(int k = 0; k < mu; ++k) m[i] += w[k] * xs[order[k]][i];
+			yw[i] = (m[i] - old[i]) / sigma;
+		}
+		
+		// ps += C^-1/2 yw, with C^-1/2 = B diag(1/D) B^T
+		vector<double> t(n, 0.0);
+		for(int j = 0; j < n; ++j) {
+			for(int i = 0; i < n; ++i) t[j] += B[i][j] * yw[i];
+			t[j] /= D[j];
+		}
+		double psn = 0;
+		for(int i = 0; i < n; ++i) {
+			double v = 0;
+			for(int j = 0; j < n; ++j) v += B[i][j] * t[j];
+			ps[i] = (1 - cs) * ps[i] + sqrt(cs * (2 - cs) * mueff) * v;
+			psn += ps[i] * ps[i];
+		}
+		psn = sqrt(psn);
+		++ gen;
+		const bool hsig = psn / sqrt(1 - pow(1 - cs, 2 * gen)) / chiN < 1.4 + 2.0 / (n + 1);
+		for(int i = 0; i < n; ++i) pc[i] = (1 - cc) * pc[i] + (hsig ? sqrt(cc * (2 - cc) * mueff) * yw[i] : 0.0);
+		
+		for(int i = 0; i < n; ++i) for(int j = 0; j < n; ++j) {
+			double rank_mu = 0;
+			for(int k = 0; k < mu; ++k) {
+				const vector<double>& x = xs[order[k]];
+				rank_mu += w[k] * (x[i] - old[i]) * (x[j] - old[j]) / (sigma * sigma);
+			}
+			C[i][j] = (1 - c1 - cmu) * C[i][j]
+			        + c1 * (pc[i] * pc[j] + (hsig ? 0.0 : cc * (2 - cc) * C[i][j]))
+			        + cmu * rank_mu;
+		}
+		sigma *= exp((cs / damps) * (psn / chiN - 1));
+		sigma = min(sigma, 1.0);
+		
+		jacobi_eigen(C, B, D);
+		for(double& d : D) d = sqrt(max(d, 1e-20));
+	}
+};
+
+// Successive halving: a bracket starts from the given params plus random
+// ones, each scored on one seed. Every rung keeps the better half and doubles
+// the seeds its survivors are averaged over, so full evaluations only go to
+// the few that survive. A finished bracket starts the next one.
+class HalvingTuner : public Tuner {
+	ParamSpace space;
+	mt19937 mt;
+	int size, base_seed;
+	SolverParams start;
+	struct Entry { SolverParams params; double sum = 0; int seeds = 0; };
+	vector<Entry> alive;
+	int rung = -1;
+
+public:
+	HalvingTuner(const ParamSpace& space, const SolverParams& start, int budget, int base_seed):
+		space(space), mt(base_seed), base_seed(base_seed), start(start) {
+		// A bracket of size s costs about s * (1 + log2(s) / 2) evaluations
+		for(size = 2; 2 * size * (1 + log2(2 * size) / 2) <= budget; size *= 2) {}
+	}
+	
+	vector<Trial> ask() override {
+		if(space.dim() == 0) return {};
+		if(rung < 0 || alive.size() <= 1) {
+			alive.assign(size, Entry());
+			alive[0].params = start;
+			for(int k = 1; k < size; ++k) alive[k].params = space.sample(mt);
+			rung = 0;
+		}
+		const int seeds = 1 << rung;
+		vector<Trial> batch;
+		for(Entry& a : alive) batch.push_back({a.params, base_seed + 1 + a.seeds, seeds - a.seeds, 0.0});
+		return batch;
+	}
+	
+	void tell(const vector<Trial>& batch) override {
+		for(size_t k = 0; k < alive.size(); ++k) {
+			alive[k].sum += batch[k].score * batch[k].seeds;
+			alive[k].seeds += batch[k].seeds;
+		}
+		stable_sort(alive.begin(), alive.end(), [](const Entry& a, const Entry& b) {
+			return a.sum / a.seeds > b.sum / b.seeds;
+		});
+		alive.resize(alive.size() / 2);
+		// The bracket winner seeds the next bracket
+		if(alive.size() == 1) start = alive[0].params;
+		++ rung;
+	}
+};
+
+unique_ptr<Tuner> make_tuner(const string& name, const ParamSpace& space,
+                             const SolverParams& start, int budget, int base_seed) {
+	if(name == "cmaes") return unique_ptr<Tuner>(new CmaesTuner(space, start, base_seed));
+	if(name == "halving") return unique_ptr<Tuner>(new HalvingTuner(space, start, budget, base_seed));
+	return nullptr;
+}
+
+// Drives a tuner until budget greedy runs are spent or time_limit seconds have
+// passed (the last batch always completes), the runs of a batch spread over
+// batch_pool. Keeps the best single run seen, starting from the given one.
+void run_tuner(const Instance& in, Tuner& tuner, int budget, bool verbose,
+               ThreadPool* pool, ThreadPool* batch_pool,
+               vector<Arm>& best_arms, int& best_score, SolverParams& best_params,
+               double time_limit = 0, TraceWriter* trace = nullptr,
+               ostream& out = cout, ostream& err = cerr) {
+	if(batch_pool && batch_pool->size() > 1) pool = nullptr; // the step pool is not reentrant
+	auto start_time = chrono::steady_clock::now();
+	
+	for(int runs = 0; runs < budget; ) {
+		vector<Trial> batch = tuner.ask();
+		if(batch.empty()) break;
+		
+		vector<pair<int, int>> jobs;  // (trial, seed)
+		for(size_t j = 0; j < batch.size(); ++j)
+			for(int s = 0; s < batch[j].seeds; ++s) jobs.push_back({j, batch[j].seed + s});
+		vi scores(jobs.size());
+		vector<vector<Arm>> arms(jobs.size());
+		parallel_for(batch_pool, jobs.size(), [&](int, int k) {
+			mt19937 mt(jobs[k].second);
+			scores[k] = greedy_solver(in, arms[k], batch[jobs[k].first].params, mt, false, pool);
+		});
+		const int runs0 = runs;
+		runs += jobs.size();
+		
+		const auto ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start_time);
+		for(size_t k = 0; k < jobs.size(); ++k) {
+			Trial& t = batch[jobs[k].first];
+			t.score += (double)scores[k] / t.seeds;
+			const bool best = scores[k] > best_score;
+			if(best) {
+				best_score = scores[k];
+				best_params = t.params;
+				best_arms = move(arms[k]);
+				out << "[" << runs << "/" << budget << "] NEW BEST: " << best_score << " points ";
+				best_params.print(err);
+			}
+			// Tuners accept no single run, only a new best is kept
+			if(trace) trace->evaluation(runs0 + k + 1, 0, ns.count(), t.params, scores[k], best, best);
+		}
+		tuner.tell(batch);
+		
+		if(verbose || runs / 10 > runs0 / 10) {
+			double batch_best = 0;
+			for(const Trial& t : batch) batch_best = max(batch_best, t.score);
+			auto now = chrono::steady_clock::now();
+			double elapsed = chrono::duration<double>(now - start_time).count();
+			out << "[" << runs << "/" << budget << "] Best: " << best_score
+			     << ", Batch: " << batch_best << ", Time: " << elapsed << "s" << endl;
+		}
+		
+		if(time_limit > 0 && chrono::duration<double>(chrono::steady_clock::now() - start_time).count() >= time_limit) {
+			out << "Time limit reached after " << runs << " runs" << endl;
+			break;
+		}
+	}
+}
+
+// ==================== Local Search ====================
+// One annealing chain of the island model
+struct SearchChain {
+	mt19937 mt;
+	SolverParams current_params, best_params;
+	int current_score = 0, best_score = 0;
+	int aborted = 0;
+	vector<Arm> best_arms;
+};
+
+// Wall-clock limit and checkpointing of a long search
+struct AnytimeOptions {
+	double time_limit = 0;           // seconds, 0 for none
+	string checkpoint;               // written at chain barriers, empty for none
+	double checkpoint_every = 300;   // seconds between checkpoints
+};
+
+// Everything needed to continue the annealing chains where they stopped. The
+// best arms keep only their mounts, tasks and paths, which is all the output needs.
+struct Checkpoint {
+	int W = 0, H = 0, R = 0, T = 0;
+	uint64_t instance = 0;  // Instance::fingerprint() of the searched input
+	int seed = 0, iterations = 0, migrate_every = 10, it = 0;
+	SolverParams initial_params;
+	ParamFixFlags fix_flags;
+	int best_score = 0;
+	SolverParams best_params;
+	vector<Arm> best_arms;
+	vector<SearchChain> chain;
+	
+	static void put(ostream& out, const SolverParams& p) {
+		for(int k = 0; k < 5; ++k) out << ' ' << p.*ParamSpace::field[k];
+		out << '\n';
+	}
+	
+	static void get(istream& in, SolverParams& p) {
+		for(int k = 0; k < 5; ++k) in >> p.*ParamSpace::field[k];
+	}
+	
+	// Written under a temporary name and renamed, so a kill never leaves a
+	// half-written checkpoint behind
+	bool save(const string& file) const {
+		const string tmp = file + ".tmp" + to_string(getpid());
+		{
+			ofstream out(tmp);
+			out << setprecision(17);
+			out << "V5CKPT 2\n";
+			out << W << ' ' << H << ' ' << R << ' ' << T << ' ' << instance << '\n';
+			out << seed << ' ' << iterations << ' ' << migrate_every << ' ' << it << '\n';
+			out << initial_params.candidate_k;
+			put(out, initial_params);
+			out << fix_flags.fix_task_eff << ' ' << fix_flags.fix_dist_penalty << ' ' << fix_flags.fix_ownership
+			    << ' ' << fix_flags.fix_path_threshold << ' ' << fix_flags.fix_bfs_random << '\n';
+			out << best_score;
+			put(out, best_params);
+			out << chain.size() << '\n';
+			for(const SearchChain& ch : chain) {
+				out << ch.current_score << ' ' << ch.best_score << ' ' << ch.aborted << '\n';
+				put(out, ch.current_params);
+				put(out, ch.best_params);
+				out << ch.mt << '\n';
+			}
+			out << best_arms.size() << '\n';
+			for(const Arm& a : best_arms) {
+				out << a.cur[0].x << ' ' << a.cur[0].y << ' ' << a.z.size() << ' ' << a.path.runs.size() << '\n';
+				for(int t : a.z) out << t << ' ';
+				out << '\n';
+				for(const Path::Run& r : a.path.runs) out << r.c << ' ' << r.n << ' ';
+				out << '\n';
+			}
+			out.close();
+			if(!out) {
+				remove(tmp.c_str());
+				return false;
+			}
+		}
+		if(rename(tmp.c_str(), file.c_str()) != 0) {
+			remove(tmp.c_str());
+			return false;
+		}
+		return true;
+	}
+	
+	// Fails on a truncated or edited file: every section must read cleanly and
+	// every count must fit the file, with 1 to 1024 chains and one arm per R
+	bool load(const string& file) {
+		struct stat st;
+		if(stat(file.c_str(), &st) != 0) return false;
+		const size_t limit = st.st_size;
+		ifstream in(file);
+		string magic;
+		int version = 0;
+		in >> magic >> version;
+		if(magic != "V5CKPT" || version != 2) return false;
+		in >> W >> H >> R >> T >> instance;
+		in >> seed >> iterations >> migrate_every >> it;
+		in >> initial_params.candidate_k;
+		get(in, initial_params);
+		in >> fix_flags.fix_task_eff >> fix_flags.fix_dist_penalty >> fix_flags.fix_ownership
+		   >> fix_flags.fix_path_threshold >> fix_flags.fix_bfs_random;
+		in >> best_score;
+		get(in, best_params);
+		if(!in.good() || W < 1 || H < 1 || R < 1 || T < 0 || iterations < 0 || migrate_every < 1 ||
+		   it < 0 || it > iterations) return false;
+		size_t n = 0;
+		in >> n;
+		if(!in.good() || n < 1 || n > 1024) return false;
+		chain.assign(n, SearchChain());
+		for(SearchChain& ch : chain) {
+			in >> ch.current_score >> ch.best_score >> ch.aborted;
+			get(in, ch.current_params);
+			get(in, ch.best_params);
+			in >> ch.mt;
+			if(!in.good()) return false;
+		}
+		in >> n;
+		if(!in.good() || n != (size_t)R) return false;
+		best_arms.clear();
+		for(size_t i = 0; i < n; ++i) {
+			int x, y;
+			size_t nz, nr;
+			in >> x >> y >> nz >> nr;
+			if(!in.good() || x < 0 || x >= W || y < 0 || y >= H || nz > limit || nr > limit) return false;
+			Arm a(x, y, i);
+			a.z.resize(nz);
+			for(int& t : a.z) {
+				in >> t;
+				if(!in.good() || t < 0 || t >= T) return false;
+			}
+			for(size_t k = 0; k < nr; ++k) {
+				char c;
+				int len;
+				in >> c >> len;
+				if(!in.good() || len < 1 || !strchr("RLUDW", c)) return false;
+				a.path.append(len, c);
+			}
+			best_arms.push_back(move(a));
+		}
+		return true;
+	}
+	
+	void set_instance(const Instance& in) {
+		W = in.W; H = in.H; R = in.R; T = in.T;
+		instance = in.fingerprint();
+	}
+	
+	bool matches(const Instance& in) const {
+		return W == in.W && H == in.H && R == in.R && T == in.T && instance == in.fingerprint();
+	}
+};
+
+tuple<vector<Arm>, int, SolverParams> local_search(
+	const Instance& in,
+	const SolverParams& initial_params,
+	int iterations, int base_seed, bool verbose,
+	const ParamFixFlags& fix_flags, ThreadPool* pool = nullptr,
+	ThreadPool* chain_pool = nullptr, int migrate_every = 10,
+	const string& tuner_name = "anneal",
+	const AnytimeOptions& anytime = AnytimeOptions(), const Checkpoint* resume = nullptr,
+	TraceWriter* trace = nullptr, ostream& out = cout, ostream& err = cerr) {
+	
+	mt19937 mt(base_seed);
+	
+	SolverParams best_params = initial_params;
+	vector<Arm> best_arms;
+	int best_score;
+	if(resume) {
+		best_params = resume->best_params;
+		best_arms = resume->best_arms;
+		best_score = resume->best_score;
+	} else {
+		best_score = greedy_solver(in, best_arms, best_params, mt, verbose, pool);
+	}
+	
+	out << "\n=== Local Search ===" << endl;
+	if(resume) out << "Resumed at iteration " << resume->it << ", best: " << best_score << " points with ";
+	else out << "Initial: " << best_score << " points with ";
+	best_params.print(err);
+	fix_flags.print(out);
+	
+	auto start_time = chrono::steady_clock::now();
+	
+	if(unique_ptr<Tuner> tuner = make_tuner(tuner_name, ParamSpace(initial_params, fix_flags),
+	                                        best_params, iterations, base_seed)) {
+		run_tuner(in, *tuner, iterations, verbose, pool, chain_pool, best_arms, best_score, best_params,
+		          anytime.time_limit, trace, out, err);
+	} else {
+		// Chain 0 carries on with the initial run's generator and seeds, so a
+		// single chain is exactly the serial search
+		const int chains = chain_pool ? chain_pool->size() : 1;
+		vector<SearchChain> chain(chains);
+		if(resume) chain = resume->chain;
+		else for(int c = 0; c < chains; ++c) {
+			SearchChain& ch = chain[c];
+			// Other chains hash their seed, which keeps their generator apart from
+			// the per-iteration seeds base_seed + c * iterations + it
+			ch.mt = c == 0 ? mt : mt19937(SplitMix64((uint64_t)(uint32_t)base_seed << 32 | c)());
+			ch.current_params = ch.best_params = best_params;
+			ch.current_score = ch.best_score = best_score;
+		}
+		if(chains > 1) {
+			out << "Chains: " << chains << ", migrating every " << migrate_every << " iterations" << endl;
+			pool = nullptr; // the step pool is not reentrant, chains already fill the cores
+		}
+		mutex console;
+		auto saved_time = start_time;
+		Checkpoint ck;
+		if(!anytime.checkpoint.empty()) ck.set_instance(in);
+		
+		for(int it0 = resume ? resume->it : 0; it0 < iterations; it0 += migrate_every) {
+			const int it1 = min(iterations, it0 + migrate_every);
+			
+			parallel_for(chain_pool, chains, [&](int, int c) {
+				SearchChain& ch = chain[c];
+				const string tag = chains > 1 ? "[chain " + to_string(c) + "] " : "";
+				for(int it = it0; it < it1; ++it) {
+					double temperature = 1.0 - ((double)it / iterations);
 					
-					// Apply randomness parameter per iteration
-					if(rand_dist(mt) < params.bfs_randomness) {
-						shuffle(vs, vs+4, mt);
-					}
+					SolverParams candidate_params = ch.current_params.mutate(ch.mt, temperature * 0.5,
+					                                                         fix_flags.fix_task_eff,
+					                                                         fix_flags.fix_dist_penalty,
+					                                                         fix_flags.fix_ownership,
+					                                                         fix_flags.fix_path_threshold,
+					                                                         fix_flags.fix_bfs_random);
 					
-					if(a.how[q.x][q.y]!='x' || q==a.cur.back()) {
-						for(int idx = 0; idx < 4; ++idx) {
-							char c = vs[idx];
-							Point p = q+c;
-							if(p.x < 0 || p.x >= W || p.y < 0 || p.y >= H || a.how[p.x][p.y] != c) continue;
-							seen[p.x][p.y] = SS;
-							dist[p.x][p.y] = l+1;
-							pred[p.x][p.y] = 'x';
-							if(p == pt) { found = true; break; }
-							Q.emplace(p, l+1, depth+1);
-						}
-					}
+					// A run that cannot get above the acceptance floor is cut short
+					vector<Arm> candidate_arms;
+					mt19937 mt_iter(base_seed + c * iterations + it);
+					int score = greedy_solver(in, candidate_arms, candidate_params, mt_iter, false, pool,
+					                          ch.current_score * 0.95);
 					
-					for(int idx = 0; idx < 4; ++idx) {
-						char c = vs[idx];
-						Point p = q+c;
-						if(p.x < 0 || p.x >= W || p.y < 0 || p.y >= H || a.how[p.x][p.y] != 'x') continue;
-						int l2 = l;
-						int j = owner[p.x][p.y];
-						if(j != i && until[p.x][p.y] > l) {
-							if(until[p.x][p.y] >= L) continue;
-							// Use ownership distance factor parameter (use cached positions)
-							if(distance(p, arm_start) > params.ownership_distance_factor * distance(p, arms[j].cur[0])) continue;
-							// Use cached task start and arm current positions
-							if(distance(P[t][0], arm_current) + arms[j].path.size() > distance(P[t][0], arms[j].cur.back()) + arms[j].path.size()) continue;
-							l2 = until[p.x][p.y];
+					const bool best = score > ch.best_score;
+					bool accepted = best;
+					if(score == ABORTED) {
+						++ ch.aborted;
+					} else if(best) {
+						ch.best_score = score;
+						ch.best_params = candidate_params;
+						ch.best_arms = move(candidate_arms);
+						ch.current_params = candidate_params;
+						ch.current_score = score;
+						lock_guard<mutex> lock(console);
+						out << tag << "[" << (it+1) << "/" << iterations << "] NEW BEST: " << score << " points ";
+						candidate_params.print(err);
+					} else if(score > ch.current_score * 0.95) {
+						uniform_real_distribution<double> dist(0.0, 1.0);
+						double delta = score - ch.current_score;
+						double prob = exp(delta / max(1.0, ch.current_score * temperature * 0.1));
+						if(dist(ch.mt) < prob * 0.3) {
+							accepted = true;
+							ch.current_params = candidate_params;
+							ch.current_score = score;
+							if(verbose) {
+								lock_guard<mutex> lock(console);
+								out << tag << "[" << (it+1) << "/" << iterations << "] Accepted worse: " << score << endl;
+							}
 						}
-						++ l2;
-						if(seen[p.x][p.y] == SS && l2 >= dist[p.x][p.y]) continue;
-						seen[p.x][p.y] = SS;
-						dist[p.x][p.y] = l2;
-						pred[p.x][p.y] = c;
-						if(p == pt) { found = true; break; }
-						Q.emplace(p, l2, depth);
+					}
+					if(trace) {
+						const auto ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start_time);
+						trace->evaluation(it+1, c, ns.count(), candidate_params, score, accepted, best, temperature);
 					}
 				}
-				
-				if(!found) { bad = true; break; }
-				
-				// Optimize path reconstruction
-				string add;
-				add.reserve(100);  // Pre-allocate to avoid reallocations
-				Point p = pt;
-				while(pred[p.x][p.y] != 'x') {
-					add.push_back(pred[p.x][p.y]);
-					p += opp(pred[p.x][p.y]);
+			});
+			
+			// Barrier: collect the global best (lowest chain wins ties), then the
+			// chain furthest behind restarts from the best params
+			int current_score = chain[0].current_score;
+			for(int c = 0; c < chains; ++c) {
+				SearchChain& ch = chain[c];
+				if(ch.best_score > best_score) {
+					best_score = ch.best_score;
+					best_params = ch.best_params;
+					best_arms = move(ch.best_arms);
 				}
-				while(a.cur.back() != p) {
-					a.path += opp(a.cp.back());
-					a.cur.pop_back();
-					a.cp.pop_back();
-					a.how[a.cur.back().x][a.cur.back().y] = 'x';
+				ch.best_arms.clear();
+				current_score = max(current_score, ch.current_score);
+			}
+			if(chains > 1) {
+				int worst = 0;
+				for(int c = 0; c < chains; ++c) {
+					chain[c].best_score = best_score;
+					chain[c].best_params = best_params;
+					if(chain[c].current_score < chain[worst].current_score) worst = c;
 				}
-				reverse(add.begin(), add.end());
-				a.cp += add;
-				for(char c : add) {
-					a.how[a.cur.back().x][a.cur.back().y] = opp(c);
-					const Point p = a.cur.back()+c;
-					int wait_steps = dist[p.x][p.y] - dist[a.cur.back().x][a.cur.back().y] - 1;
-					if(wait_steps > 0) {
-						a.path.append(wait_steps, 'W');
-					}
-					a.path += c;
-					a.cur.push_back(p);
+				if(chain[worst].current_score < best_score) {
+					chain[worst].current_params = best_params;
+					chain[worst].current_score = best_score;
 				}
-				if(a.path.size() > L) { bad = true; break; }
 			}
 			
-			if(bad) continue;
-			
-			int path_diff = a.path.size() - arms[i].path.size();
-			if(path_diff <= 0) continue;
-			
-			double sc = (double)S[t] / path_diff;
-			if(sc > bestS) {
-				bestA = move(a);
-				bestS = sc;
-				bestT = t;
+			auto now = chrono::steady_clock::now();
+			double elapsed = chrono::duration<double>(now - start_time).count();
+			if(it1 / 10 > it0 / 10) {
+				out << "[" << it1 << "/" << iterations << "] Best: " << best_score 
+				     << ", Current: " << current_score << ", Time: " << elapsed << "s" << endl;
 			}
-		}
-		
-		if(bestT == -1) {
-			if(arms[i].cur.size() <= 1) {
-				arms[i].done = true;
-				continue;
+			
+			// Checkpoint between epochs, where the chains hold no half-done work
+			const bool out_of_time = anytime.time_limit > 0 && elapsed >= anytime.time_limit;
+			if(!anytime.checkpoint.empty() && (out_of_time || it1 == iterations ||
+			   chrono::duration<double>(now - saved_time).count() >= anytime.checkpoint_every)) {
+				ck.seed = base_seed;
+				ck.iterations = iterations;
+				ck.migrate_every = migrate_every;
+				ck.it = it1;
+				ck.initial_params = initial_params;
+				ck.fix_flags = fix_flags;
+				ck.best_score = best_score;
+				ck.best_params = best_params;
+				ck.best_arms = best_arms;
+				ck.chain = chain;
+				if(!ck.save(anytime.checkpoint)) err << "Could not write checkpoint: " << anytime.checkpoint << endl;
+				saved_time = now;
 			}
-			while(arms[i].cur.size() > 1 && arms[i].path.size() < L) {
-				Point p = arms[i].cur.back();
-				until[p.x][p.y] = arms[i].path.size();
-				arms[i].path.push_back(opp(arms[i].cp.back()));
-				arms[i].cur.pop_back();
-				arms[i].cp.pop_back();
-				arms[i].how[arms[i].cur.back().x][arms[i].cur.back().y] = 'x';
+			if(out_of_time) {
+				out << "Time limit reached after " << it1 << " iterations" << endl;
+				break;
 			}
-			for(int j = 0; j < R; ++j) if(arms[j].path.size() < L) arms[j].done = false;
-			arms[i].done = true;
-			continue;
 		}
 		
-		Point p = arms[i].cur.back();
-		for(int l = arms[i].path.size(); l < bestA.path.size(); ++l) if(bestA.path[l] != 'W') {
-			if(bestA.how[p.x][p.y] == 'x' && p != bestA.cur.back()) until[p.x][p.y] = l;
-			p += bestA.path[l];
-			owner[p.x][p.y] = i;
-			until[p.x][p.y] = L;
-		}
-		arms[i] = move(bestA);
-		score += S[bestT];
-		
-		int ind = 0;
-		while(ts[ind] != bestT) ++ind;
-		swap(ts[ind], ts.back());
-		ts.pop_back();
-		arms[i].z.push_back(bestT);
-		if(verbose) cerr << score << '\n';
-		
-		for(int j = 0; j < R; ++j) if(arms[j].path.size() < L) arms[j].done = false;
+		int aborted = 0;
+		for(const SearchChain& ch : chain) aborted += ch.aborted;
+		out << "Aborted early: " << aborted << " of " << chains * iterations << " runs" << endl;
 	}
 	
-	if(verbose) {
-		cerr << "restant: " << ts.size() << endl;
-		cerr << score << '\n';
+	auto end_time = chrono::steady_clock::now();
+	double total_time = chrono::duration<double>(end_time - start_time).count();
+	
+	out << "\n=== Final Best ===" << endl;
+	out << "Score: " << best_score << endl;
+	out << "Params: ";
+	best_params.print(err);
+	out << "Time: " << total_time << "s" << endl;
+	
+	return {best_arms, best_score, best_params};
+}
+
+// ==================== Large Neighbourhood Search ====================
+// Picks the part of a solution to throw away, as the log position from which
+// each arm loses all its changes (log.size() for arms left alone). Either the
+// last few tasks of a few arms, or every arm's work from its first task that
+// starts inside a random window.
+vi ruin(const Instance& in, const SolverState& st, mt19937& mt) {
+	const vector<SolverState::Commit>& log = st.log;
+	vi cut(in.R, log.size());
+	vector<vi> tasks_of(in.R);  // log positions of each arm's task commits
+	vi committed;
+	for(size_t k = 0; k < log.size(); ++k) if(log[k].task >= 0) {
+		tasks_of[log[k].arm].push_back(k);
+		committed.push_back(k);
 	}
+	if(committed.empty()) return cut;
 	
-	return score;
+	if(mt() % 2 == 0) {
+		const int arms = 1 + mt() % 3;
+		for(int n = 0; n < arms; ++n) {
+			const vi& z = tasks_of[log[committed[mt() % committed.size()]].arm];
+			const int k = 1 + mt() % min<size_t>(3, z.size());
+			cut[log[z[0]].arm] = z[z.size() - k];
+		}
+	} else {
+		const Point c = in.P[log[committed[mt() % committed.size()]].task][0];
+		const int r = max(2, (in.W + in.H) / 20);
+		for(int k : committed) {
+			const Point& p = in.P[log[k].task][0];
+			if(abs(p.x - c.x) <= r && abs(p.y - c.y) <= r) cut[log[k].arm] = min(cut[log[k].arm], k);
+		}
+	}
+	return cut;
 }
 
-// ==================== Local Search ====================
-tuple<vector<Arm>, int, SolverParams> local_search(
-	int W, int H, int R, int M, int T, int L,
-	vector<Point> ms, vi S, vector<vector<Point>> P, vi Len,
-	const SolverParams& initial_params,
-	int iterations, int base_seed, bool verbose,
-	const ParamFixFlags& fix_flags) {
+// Ruin-and-recreate on whole solutions: drop part of the current solution,
+// replay the rest, and let the greedy insertion fill the gap again. A replay
+// that no longer fits cuts the arm that broke it too, until everything fits.
+tuple<vector<Arm>, int, SolverParams> lns_search(
+	const Instance& in, const SolverParams& params,
+	int iterations, int base_seed, bool verbose, ThreadPool* pool = nullptr,
+	ostream& out = cout, ostream& err = cerr) {
 	
 	mt19937 mt(base_seed);
+	SolverState best;
+	init_state(in, params, mt, verbose, best);
+	greedy_run(in, best, params, mt, verbose, pool);
+	SolverState current = best;
 	
-	SolverParams best_params = initial_params;
-	vector<Arm> best_arms;
-	int best_score = greedy_solver(W, H, R, M, T, L, ms, S, P, Len, best_arms, best_params, mt, verbose);
-	
-	cout << "\n=== Local Search ===" << endl;
-	cout << "Initial: " << best_score << " points with ";
-	best_params.print();
-	fix_flags.print();
-	
-	SolverParams current_params = best_params;
-	int current_score = best_score;
+	out << "\n=== Large Neighbourhood Search ===" << endl;
+	out << "Initial: " << best.score << " points" << endl;
 	
 	auto start_time = chrono::steady_clock::now();
 	
 	for(int it = 0; it < iterations; ++it) {
 		double temperature = 1.0 - ((double)it / iterations);
+		mt19937 mt_iter(base_seed + it);
 		
-		SolverParams candidate_params = current_params.mutate(mt, temperature * 0.5,
-		                                                      fix_flags.fix_task_eff,
-		                                                      fix_flags.fix_dist_penalty,
-		                                                      fix_flags.fix_ownership,
-		                                                      fix_flags.fix_path_threshold,
-		                                                      fix_flags.fix_bfs_random);
+		vi cut = ruin(in, current, mt_iter);
+		vector<SolverState::Commit> log;
+		vi pos;  // position of each kept change in current.log
+		SolverState cand;
+		cand.ms = current.ms;
+		cand.keep = current.keep;
+		cand.rank = current.rank;
+		for(int bad = 0; bad >= 0; ) {
+			log.clear();
+			pos.clear();
+			for(size_t k = 0; k < current.log.size(); ++k) {
+				if((int)k >= cut[current.log[k].arm]) continue;
+				log.push_back(current.log[k]);
+				pos.push_back(k);
+			}
+			bad = replay(in, cand, log);
+			if(bad >= 0) cut[log[bad].arm] = pos[bad];
+		}
+		if(verbose) err << "LNS " << it << ": kept " << log.size() << " of " << current.log.size() << " changes" << endl;
+		int score = greedy_run(in, cand, params, mt_iter, false, pool);
 		
-		vector<Arm> candidate_arms;
-		mt19937 mt_iter(base_seed + it);
-		int score = greedy_solver(W, H, R, M, T, L, ms, S, P, Len, 
-		                         candidate_arms, candidate_params, mt_iter, false);
-		
-		if(score > best_score) {
-			best_score = score;
-			best_params = candidate_params;
-			best_arms = candidate_arms;
-			current_params = candidate_params;
-			current_score = score;
-			cout << "[" << (it+1) << "/" << iterations << "] NEW BEST: " << score << " points ";
-			candidate_params.print();
-		} else if(score > current_score * 0.95) {
+		if(score > best.score) {
+			best = cand;
+			current = move(cand);
+			out << "[" << (it+1) << "/" << iterations << "] NEW BEST: " << score << " points" << endl;
+		} else if(score > current.score * 0.95) {
 			uniform_real_distribution<double> dist(0.0, 1.0);
-			double delta = score - current_score;
-			double prob = exp(delta / max(1.0, current_score * temperature * 0.1));
+			double delta = score - current.score;
+			double prob = exp(delta / max(1.0, current.score * temperature * 0.1));
 			if(dist(mt) < prob * 0.3) {
-				current_params = candidate_params;
-				current_score = score;
-				if(verbose) cout << "[" << (it+1) << "/" << iterations << "] Accepted worse: " << score << endl;
+				current = move(cand);
+				if(verbose) out << "[" << (it+1) << "/" << iterations << "] Accepted worse: " << score << endl;
 			}
 		}
 		
 		if((it + 1) % 10 == 0) {
 			auto now = chrono::steady_clock::now();
 			double elapsed = chrono::duration<double>(now - start_time).count();
-			cout << "[" << (it+1) << "/" << iterations << "] Best: " << best_score 
-			     << ", Current: " << current_score << ", Time: " << elapsed << "s" << endl;
+			out << "[" << (it+1) << "/" << iterations << "] Best: " << best.score 
+			     << ", Current: " << current.score << ", Time: " << elapsed << "s" << endl;
 		}
 	}
 	
-	auto end_time = chrono::steady_clock::now();
-	double total_time = chrono::duration<double>(end_time - start_time).count();
-	
-	cout << "\n=== Final Best ===" << endl;
-	cout << "Score: " << best_score << endl;
-	cout << "Params: ";
-	best_params.print();
-	cout << "Time: " << total_time << "s" << endl;
+	double total_time = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
+	out << "LNS best: " << best.score << " points, Time: " << total_time << "s" << endl;
 	
-	return {best_arms, best_score, best_params};
+	return {best.arms, best.score, params};
 }
 
 // ==================== I/O ====================
-void write_output(const vector<Arm>& arms, const string& filename) {
-	ofstream out(filename);
-	int A = 0;
-	for(const Arm &a : arms) if(!a.z.empty()) ++A;
-	out << A << '\n';
+// Formats the whole solution into one buffer sized up front, expanding path
+// runs in place, and hands it to the kernel in a single write
+bool write_output(const vector<Arm>& arms, const string& filename) {
+	size_t bytes = 16, A = 0;
 	for(const Arm &a : arms) if(!a.z.empty()) {
-		out << a.cur[0].x << ' ' << a.cur[0].y << ' ' << a.z.size() << ' ' << a.path.size() << '\n';
-		for(int t : a.z) out << t << ' ';
-		out << '\n';
-		for(char c : a.path) out << c << ' ';
-		out << '\n';
+		++ A;
+		bytes += 48 + 12 * a.z.size() + 2 * a.path.size();
+	}
+	string buf(bytes, ' ');
+	char* o = &buf[0];
+	auto num = [&](long v, char sep) {
+		o = to_chars(o, &buf[0] + bytes, v).ptr;
+		*o++ = sep;
+	};
+	num(A, '\n');
+	for(const Arm &a : arms) if(!a.z.empty()) {
+		num(a.cur[0].x, ' ');
+		num(a.cur[0].y, ' ');
+		num(a.z.size(), ' ');
+		num(a.path.size(), '\n');
+		for(int t : a.z) num(t, ' ');
+		*o++ = '\n';
+		for(const Path::Run& r : a.path.runs) {
+			for(int k = 0; k < r.n; ++k) {
+				o[0] = r.c;
+				o[1] = ' ';
+				o += 2;
+			}
+		}
+		*o++ = '\n';
+	}
+	
+	const int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if(fd < 0) return false;
+	const char* p = buf.data();
+	for(size_t left = o - p; left > 0; ) {
+		const ssize_t n = write(fd, p, left);
+		if(n < 0) {
+			if(errno == EINTR) continue;
+			close(fd);
+			return false;
+		}
+		p += n;
+		left -= n;
 	}
+	return close(fd) == 0;
 }
 
 string get_fixed_param_name(const ParamFixFlags& fix_flags) {
@@ -532,7 +2641,8 @@ void write_params_json(const string& filename,
                       int iterations,
                       int seed,
                       bool local_search_mode,
-                      double execution_time_minutes) {
+                      double execution_time_minutes,
+                      bool with_profile = true) {
 	ofstream out(filename);
 	out << "{\n";
 	out << "  \"map\": \"" << map_name << "\",\n";
@@ -570,35 +2680,699 @@ void write_params_json(const string& filename,
 		out << "    \"fix_bfs_random\": " << (fix_flags.fix_bfs_random ? "true" : "false") << "\n";
 		out << "  }";
 	}
+#ifdef V5_PROFILE
+	if(with_profile) {
+		out << ",\n";
+		profile.write_json(out);
+	}
+#else
+	(void)with_profile;
+#endif
 	out << "\n}\n";
 }
 
 // ==================== Main ====================
-int main(int argc, char* argv[]) {
-	ios::sync_with_stdio(false);
-	cin.tie(nullptr);
-	
-	// Parse arguments
-	string map_name = "";
+// Left out when the solver is built into another program, like bench/bench.cpp
+#ifndef V5_NO_MAIN
+// Settings shared by every map of one run
+struct RunOptions {
 	bool verbose = false;
 	bool local_search_mode = false;
 	int iterations = 50;
 	int seed = -1;  // -1 means use random seed
+	int step_threads = 1;
+	int threads = 1;
+	int migrate_every = 10;
+	int lns_iterations = 0;
+	string tuner = "anneal";
+	AnytimeOptions anytime;
+	string resume_file;
+	string trace_file;
 	SolverParams params;
 	ParamFixFlags fix_flags;
+	bool write_files = true;  // output and params files under output/
+	bool write_profile = true;  // the process-wide counters, which only add up to one map run alone
+};
+
+// One map of a run: its display name, input file and output file prefix
+struct MapJob {
+	string name, input_file, base_name;
+};
+
+struct MapResult {
+	int score = 0;
+	double seconds = 0;
+	string output_file;
+};
+
+// Input file of a map letter, empty when there is no such map
+string map_input(char letter) {
+	static const char* files[] = {"a_example.txt", "b_single_arm.txt", "c_few_arms.txt",
+	                              "d_tight_schedule.txt", "e_dense_workspace.txt", "f_decentralized.txt"};
+	int k = toupper(letter) - 'A';
+	if(k < 0 || k >= 6) return "";
+	return string("input/") + files[k];
+}
+
+// Adds comma separated items of list to items
+void split_list(const string& list, vector<string>& items) {
+	size_t b = 0;
+	while(b <= list.size()) {
+		size_t e = list.find(',', b);
+		if(e == string::npos) e = list.size();
+		if(e > b) items.push_back(list.substr(b, e - b));
+		b = e + 1;
+	}
+}
+
+// Runs the search configured by opt on one loaded map and writes its output
+// and params files. Messages go to out and err so that maps solved side by
+// side can print their reports whole.
+MapResult solve_map(const MapJob& job, const Instance& in, RunOptions opt,
+                    const Checkpoint* resume, ostream& out, ostream& err) {
+	if(opt.anytime.checkpoint.empty() && opt.anytime.time_limit > 0 && opt.local_search_mode && opt.tuner == "anneal" &&
+	   opt.write_files)
+		opt.anytime.checkpoint = "output/" + job.base_name + "_" + to_string(opt.seed) + ".ckpt";
+	
+	out << "Simulation parameters:" << endl;
+	out << "Map: " << job.name << endl;
+	out << "Seed: " << opt.seed << endl;
+	out << "Local Search: " << (opt.local_search_mode ? "true" : "false") << endl;
+	if(opt.local_search_mode) {
+		out << "Iterations: " << opt.iterations << endl;
+		out << "Tuner: " << opt.tuner << endl;
+		if(opt.anytime.time_limit > 0) out << "Time limit: " << opt.anytime.time_limit << "s" << endl;
+		if(!opt.anytime.checkpoint.empty()) out << "Checkpoint: " << opt.anytime.checkpoint << endl;
+		out << "Threads: " << opt.threads << endl;
+		opt.fix_flags.print(out);
+	}
+	if(opt.lns_iterations > 0) out << "LNS iterations: " << opt.lns_iterations << endl;
+	out << "Initial params: ";
+	opt.params.print(err);
+	
+	// Solve with timing
+	auto start_time = chrono::steady_clock::now();
+	
+	vector<Arm> arms;
+	int score;
+	SolverParams final_params = opt.params;
+	unique_ptr<ThreadPool> pool;
+	if(opt.step_threads > 1) pool.reset(new ThreadPool(opt.step_threads));
+	unique_ptr<ThreadPool> chain_pool;
+	if(opt.local_search_mode && opt.threads > 1) chain_pool.reset(new ThreadPool(opt.threads));
+	unique_ptr<TraceWriter> trace;
+	if(!opt.trace_file.empty()) {
+		trace.reset(new TraceWriter(opt.trace_file));
+		if(!trace->ok()) {
+			err << "Could not open file: " << opt.trace_file << endl;
+			return MapResult{-1, 0, ""};
+		}
+	}
+	
+	if(opt.local_search_mode) {
+		auto [best_arms, best_score, final_params_result] = local_search(
+			in, opt.params, opt.iterations, opt.seed, opt.verbose, opt.fix_flags, pool.get(),
+			chain_pool.get(), opt.migrate_every, opt.tuner, opt.anytime,
+			resume, trace.get(), out, err
+		);
+		arms = best_arms;
+		score = best_score;
+		final_params = final_params_result;
+	} else {
+		mt19937 mt(opt.seed);
+		score = greedy_solver(in, arms, opt.params, mt, opt.verbose, pool.get());
+		final_params = opt.params;
+	}
+	
+	if(opt.lns_iterations > 0) {
+		auto [lns_arms, lns_score, lns_params] = lns_search(in, final_params, opt.lns_iterations, opt.seed, opt.verbose, pool.get(), out, err);
+		if(lns_score > score) {
+			arms = move(lns_arms);
+			score = lns_score;
+		}
+	}
+	
+	auto end_time = chrono::steady_clock::now();
+	double execution_time_seconds = chrono::duration<double>(end_time - start_time).count();
+	double execution_time_minutes = execution_time_seconds / 60.0;
+	
+	string output_file, json_file;
+	if(opt.write_files) {
+		// Write output
+		output_file = "output/" + job.base_name + "_" + to_string(score) + ".out";
+		PROF_TIMER(output_ns);
+		if(!write_output(arms, output_file)) err << "Could not write file: " << output_file << endl;
+		PROF_STOP(output_ns);
+		
+		// Write params JSON file with same base name
+		json_file = "output/" + job.base_name + "_" + to_string(score) + ".json";
+		write_params_json(json_file, opt.params, final_params, opt.fix_flags, 
+		                 job.name, score, opt.iterations, opt.seed, opt.local_search_mode, execution_time_minutes,
+		                 opt.write_profile);
+	}
+	
+	out << "\nFinal score: " << (score < 1000 ? to_string(score) : to_string(score/1000) + " K") << endl;
+	if(opt.write_files) {
+		out << "Saved: " << output_file << endl;
+		out << "Params: " << json_file << endl;
+	}
+	
+	return MapResult{score, execution_time_seconds, output_file};
+}
+
+// Splits a budget of total workers over the loaded maps in proportion to
+// their size (arms x reach x board), at least one each
+vi share_workers(const vector<unique_ptr<Instance>>& ins, int total) {
+	int n = ins.size();
+	vector<double> weight(n);
+	double sum = 0;
+	for(int k = 0; k < n; ++k) {
+		weight[k] = (double)ins[k]->R * ins[k]->L * (ins[k]->W + ins[k]->H);
+		sum += weight[k];
+	}
+	vi share(n, 1);
+	int spare = total - n;
+	if(spare <= 0 || sum <= 0) return share;
+	// Whole parts first, the leftover workers go to the largest remainders
+	vector<pair<double, int>> rest;
+	int given = 0;
+	for(int k = 0; k < n; ++k) {
+		double exact = spare * weight[k] / sum;
+		share[k] += (int)exact;
+		given += (int)exact;
+		rest.push_back({exact - (int)exact, k});
+	}
+	sort(rest.begin(), rest.end(), [](const pair<double, int>& a, const pair<double, int>& b) {
+		return a.first != b.first ? a.first > b.first : a.second < b.second;
+	});
+	for(int k = 0; given < spare; ++k, ++given) share[rest[k].second] ++;
+	return share;
+}
+
+// Flat JSON object of one request line. Values are kept as their raw JSON
+// text; a nested object is flattened into "outer.inner" keys.
+struct JsonFields {
+	map<string, string> raw;
+	
+	bool parse(const string& line, string& error) {
+		size_t i = 0;
+		if(!object(line, i, "", error)) return false;
+		skip(line, i);
+		if(i != line.size()) return fail(error, "trailing characters");
+		return true;
+	}
+	
+	// The typed getters below return def for a missing field. A field of
+	// another type, or out of range, also gives def and is named in bad.
+	mutable string bad;
+	
+	bool has(const string& key) const { return raw.count(key) > 0; }
+	
+	string str(const string& key, const string& def = "") const {
+		auto it = raw.find(key);
+		if(it == raw.end()) return def;
+		const string& v = it->second;
+		if(v.empty() || v[0] != '"') return wrong(key, def);
+		string s;
+		for(size_t i = 1; i + 1 < v.size(); ++i) {
+			if(v[i] != '\\') { s += v[i]; continue; }
+			char c = v[++i];
+			s += c == 'n' ? '\n' : c == 't' ? '\t' : c;
+		}
+		return s;
+	}
+	
+	double num(const string& key, double def) const {
+		auto it = raw.find(key);
+		if(it == raw.end()) return def;
+		double v;
+		return number(it->second, v) ? v : wrong(key, def);
+	}
+	
+	int integer(const string& key, int def, int lo, int hi) const {
+		const double v = num(key, def);
+		return v == floor(v) && v >= lo && v <= hi ? (int)v : wrong(key, def);
+	}
+	
+	bool flag(const string& key, bool def) const {
+		auto it = raw.find(key);
+		if(it == raw.end()) return def;
+		if(it->second != "true" && it->second != "false") return wrong(key, def);
+		return it->second == "true";
+	}
+	
+	// The id as written when it is a string or number literal, null otherwise
+	string id() const {
+		auto it = raw.find("id");
+		double v;
+		if(it == raw.end() || !(it->second[0] == '"' || number(it->second, v))) return "null";
+		return it->second;
+	}
+
+private:
+	static bool fail(string& error, const char* what) {
+		error = what;
+		return false;
+	}
+	
+	template<class T> T wrong(const string& key, T def) const {
+		if(bad.empty()) bad = key;
+		return def;
+	}
+	
+	// A whole JSON number literal
+	static bool number(const string& v, double& x) {
+		if(v.empty() || !(v[0] == '-' || isdigit((unsigned char)v[0]))) return false;
+		char* end;
+		x = strtod(v.c_str(), &end);
+		return end == v.c_str() + v.size() && isfinite(x);
+	}
+	
+	static void skip(const string& s, size_t& i) {
+		while(i < s.size() && isspace((unsigned char)s[i])) ++i;
+	}
+	
+	static bool string_end(const string& s, size_t& i) {
+		for(++i; i < s.size(); ++i) {
+			if(s[i] == '\\') ++i;
+			else if(s[i] == '"') { ++i; return true; }
+		}
+		return false;
+	}
+	
+	bool object(const string& s, size_t& i, const string& prefix, string& error) {
+		skip(s, i);
+		if(i >= s.size() || s[i] != '{') return fail(error, "expected an object");
+		++i;
+		skip(s, i);
+		if(i < s.size() && s[i] == '}') { ++i; return true; }
+		while(true) {
+			skip(s, i);
+			size_t b = i;
+			if(i >= s.size() || s[i] != '"' || !string_end(s, i)) return fail(error, "expected a key");
+			string key = prefix + s.substr(b + 1, i - b - 2);
+			skip(s, i);
+			if(i >= s.size() || s[i] != ':') return fail(error, "expected ':'");
+			++i;
+			skip(s, i);
+			if(i < s.size() && s[i] == '{') {
+				if(!object(s, i, key + ".", error)) return false;
+			} else {
+				b = i;
+				if(i < s.size() && s[i] == '"') {
+					if(!string_end(s, i)) return fail(error, "unterminated string");
+				} else {
+					while(i < s.size() && s[i] != ',' && s[i] != '}' && !isspace((unsigned char)s[i])) ++i;
+				}
+				if(i == b) return fail(error, "expected a value");
+				raw[key] = s.substr(b, i - b);
+			}
+			skip(s, i);
+			if(i < s.size() && s[i] == ',') { ++i; continue; }
+			if(i < s.size() && s[i] == '}') { ++i; return true; }
+			return fail(error, "expected ',' or '}'");
+		}
+	}
+};
+
+string json_quote(const string& s) {
+	string q = "\"";
+	for(char c : s) {
+		if(c == '"' || c == '\\') q += '\\', q += c;
+		else if(c == '\n') q += "\\n";
+		else if(c == '\t') q += "\\t";
+		else if((unsigned char)c >= 0x20) q += c;
+	}
+	return q + "\"";
+}
+
+// Stream buffer that hands every finished line to a callback, used to turn a
+// job's report into progress events as it is written
+class LineBuf : public streambuf {
+	string line;
+	function<void(const string&)> emit;
+
+protected:
+	int overflow(int c) override {
+		if(c == EOF) return c;
+		if(c == '\n') {
+			if(!line.empty()) emit(line);
+			line.clear();
+		} else {
+			line += (char)c;
+		}
+		return c;
+	}
+
+public:
+	explicit LineBuf(function<void(const string&)> emit): emit(move(emit)) {}
+	~LineBuf() { if(!line.empty()) emit(line); }
+};
+
+// Solver kept running on a Unix socket. Clients send one JSON job per line and
+// get JSON lines back; each job runs on one of the worker threads against
+// instances loaded once and kept for the life of the server.
+//
+// Job fields, all optional except map:
+//   id, map ("B"), seed, local_search, iterations, tuner,
+//   time_limit, threads, step_threads, migrate_every, lns, candidate_k,
+//   task_eff, dist_penalty, ownership_factor, path_threshold, bfs_random,
+//   fix_task_eff, fix_dist_penalty, fix_ownership_factor, fix_path_threshold,
+//   fix_bfs_random, progress (default true), write (default true)
+// Replies carry the job's id and an event: "progress" with one report line,
+// "result" with score, seconds and output, or "error" with a message.
+// {"cmd": "shutdown"} finishes the queued jobs and stops the server.
+class SolveServer {
+	// Replies from several workers to one client go out whole lines at a time
+	struct Client {
+		int fd;
+		mutex m;
+		
+		explicit Client(int fd): fd(fd) {}
+		~Client() { close(fd); }
+		
+		void send(const string& line) {
+			lock_guard<mutex> lk(m);
+			for(size_t n = 0; n < line.size(); ) {
+				ssize_t k = ::send(fd, line.data() + n, line.size() - n, MSG_NOSIGNAL);
+				if(k <= 0) return;  // client gone, the job still writes its files
+				n += k;
+			}
+		}
+	};
+	
+	struct Job {
+		shared_ptr<Client> client;
+		JsonFields fields;
+	};
+	
+	RunOptions defaults;
+	int listen_fd = -1;
+	mutex m;
+	condition_variable cv;
+	deque<Job> queue;
+	bool stop = false;
+	vector<weak_ptr<Client>> clients;
+	int readers = 0;
+	condition_variable readers_cv;
+	mutex instances_m;
+	map<string, unique_ptr<Instance>> instances;
+	
+	// Loaded on first use, then shared read-only by all jobs
+	const Instance* instance(const string& file) {
+		lock_guard<mutex> lk(instances_m);
+		unique_ptr<Instance>& in = instances[file];
+		if(!in) {
+			in.reset(new Instance());
+			PROF_TIMER(preprocess_ns);
+			if(!in->load(file)) {
+				in.reset();
+				return nullptr;
+			}
+		}
+		return in.get();
+	}
+	
+	static string reply(const JsonFields& f, const string& event, const string& rest) {
+		return "{\"id\":" + f.id() + ",\"event\":\"" + event + "\"" + rest + "}\n";
+	}
+	
+	static string error(const JsonFields& f, const string& message) {
+		return reply(f, "error", ",\"message\":" + json_quote(message));
+	}
+	
+	static bool known(const string& key) {
+		static const char* keys[] = {
+			"cmd", "id", "map", "seed", "local_search", "iterations", "tuner", "time_limit",
+			"threads", "step_threads", "migrate_every", "lns", "candidate_k", "task_eff", "dist_penalty",
+			"ownership_factor", "path_threshold", "bfs_random", "fix_task_eff", "fix_dist_penalty",
+			"fix_ownership_factor", "fix_path_threshold", "fix_bfs_random", "progress", "write"};
+		for(const char* k : keys) if(key == k) return true;
+		return false;
+	}
+	
+	void run(const Job& job) {
+		const JsonFields& f = job.fields;
+		// Only the known maps, clients do not name files the server reads or
+		// writes a cache next to
+		const string name = f.str("map");
+		const string file = name.size() == 1 ? map_input(name[0]) : "";
+		if(!f.bad.empty() || file.empty()) {
+			job.client->send(error(f, "unknown map: " + name));
+			return;
+		}
+		const MapJob map_job = {string(1, toupper(name[0])), file, string(1, tolower(name[0]))};
+		
+		// Each job can use at most as many threads as the machine has
+		const int cores = max(1, (int)thread::hardware_concurrency());
+		RunOptions opt = defaults;
+		SolverParams& p = opt.params;
+		ParamFixFlags& fix = opt.fix_flags;
+		opt.local_search_mode = f.flag("local_search", opt.local_search_mode);
+		opt.iterations = f.integer("iterations", opt.iterations, 0, INT_MAX);
+		opt.tuner = f.str("tuner", opt.tuner);
+		opt.anytime.time_limit = f.num("time_limit", opt.anytime.time_limit);
+		opt.threads = f.integer("threads", min(opt.threads, cores), 1, cores);
+		opt.step_threads = f.integer("step_threads", min(opt.step_threads, cores), 1, cores);
+		opt.migrate_every = f.integer("migrate_every", opt.migrate_every, 1, INT_MAX);
+		opt.lns_iterations = f.integer("lns", opt.lns_iterations, 0, INT_MAX);
+		opt.write_files = f.flag("write", true);
+		p.candidate_k = f.integer("candidate_k", p.candidate_k, 0, INT_MAX);
+		p.task_efficiency_weight = f.num("task_eff", p.task_efficiency_weight);
+		p.distance_penalty = f.num("dist_penalty", p.distance_penalty);
+		p.ownership_distance_factor = f.num("ownership_factor", p.ownership_distance_factor);
+		p.path_cost_threshold = f.num("path_threshold", p.path_cost_threshold);
+		p.bfs_randomness = f.num("bfs_random", p.bfs_randomness);
+		fix.fix_task_eff = f.flag("fix_task_eff", fix.fix_task_eff);
+		fix.fix_dist_penalty = f.flag("fix_dist_penalty", fix.fix_dist_penalty);
+		fix.fix_ownership = f.flag("fix_ownership_factor", fix.fix_ownership);
+		fix.fix_path_threshold = f.flag("fix_path_threshold", fix.fix_path_threshold);
+		fix.fix_bfs_random = f.flag("fix_bfs_random", fix.fix_bfs_random);
+		const bool progress = f.flag("progress", true);
+		if(f.has("seed")) {
+			opt.seed = f.integer("seed", 0, INT_MIN, INT_MAX);
+		} else {
+			random_device rd;
+			opt.seed = rd();
+		}
+		if(!f.bad.empty()) {
+			job.client->send(error(f, "bad value for " + f.bad + (f.bad == "threads" || f.bad == "step_threads"
+			                                                        ? ", at most " + to_string(cores) : "")));
+			return;
+		}
+		if(opt.tuner != "anneal" && opt.tuner != "cmaes" && opt.tuner != "halving") {
+			job.client->send(error(f, "unknown tuner: " + opt.tuner));
+			return;
+		}
+		const Instance* in = instance(map_job.input_file);
+		if(!in) {
+			job.client->send(error(f, "bad input: " + map_job.input_file));
+			return;
+		}
+		
+		// The report becomes progress events, or is dropped
+		LineBuf buf([&](const string& line) {
+			if(progress) job.client->send(reply(f, "progress", ",\"line\":" + json_quote(line)));
+		});
+		ostream report(&buf);
+		MapResult res = solve_map(map_job, *in, opt, nullptr, report, report);
+		report.flush();
+		
+		char rest[64];
+		snprintf(rest, sizeof rest, ",\"score\":%d,\"seconds\":%.4f", res.score, res.seconds);
+		job.client->send(reply(f, "result", ",\"map\":" + json_quote(map_job.name) + rest +
+		                                    ",\"seed\":" + to_string(opt.seed) +
+		                                    ",\"output\":" + json_quote(res.output_file)));
+	}
+	
+	void work() {
+		while(true) {
+			unique_lock<mutex> lk(m);
+			cv.wait(lk, [&] { return stop || !queue.empty(); });
+			if(queue.empty()) return;
+			Job job = move(queue.front());
+			queue.pop_front();
+			lk.unlock();
+			run(job);
+		}
+	}
+	
+	// Reads the client's jobs until it hangs up
+	void read(shared_ptr<Client> client) {
+		string pending;
+		char buf[4096];
+		ssize_t n;
+		while((n = recv(client->fd, buf, sizeof buf, 0)) > 0) {
+			pending.append(buf, n);
+			size_t b = 0, e;
+			while((e = pending.find('\n', b)) != string::npos) {
+				string line = pending.substr(b, e - b);
+				b = e + 1;
+				if(line.find_first_not_of(" \t\r") == string::npos) continue;
+				Job job{client, JsonFields()};
+				string why;
+				if(!job.fields.parse(line, why)) {
+					client->send(error(job.fields, "bad request: " + why));
+					continue;
+				}
+				for(const auto& kv : job.fields.raw) if(why.empty() && !known(kv.first)) why = "unknown field " + kv.first;
+				if(job.fields.has("id") && job.fields.id() == "null") why = "id must be a string or number";
+				if(!why.empty()) {
+					client->send(error(job.fields, "bad request: " + why));
+					continue;
+				}
+				if(job.fields.str("cmd") == "shutdown") {
+					shutdown_server();
+					return;
+				}
+				lock_guard<mutex> lk(m);
+				if(stop) return;
+				queue.push_back(move(job));
+				cv.notify_one();
+			}
+			pending.erase(0, b);
+		}
+	}
+	
+	void shutdown_server() {
+		{
+			lock_guard<mutex> lk(m);
+			stop = true;
+		}
+		cv.notify_all();
+		::shutdown(listen_fd, SHUT_RDWR);  // wakes the accept loop
+	}
+
+public:
+	explicit SolveServer(const RunOptions& defaults): defaults(defaults) {}
+	
+	// Serves until a shutdown request, returns false with the reason in error
+	// when the socket cannot be set up
+	bool serve(const string& path, int workers, string& error) {
+		sockaddr_un addr;
+		memset(&addr, 0, sizeof addr);
+		addr.sun_family = AF_UNIX;
+		if(path.size() >= sizeof addr.sun_path) {
+			error = "socket path too long";
+			return false;
+		}
+		strcpy(addr.sun_path, path.c_str());
+		// Only a socket left behind by an earlier server is replaced
+		struct stat st;
+		if(lstat(path.c_str(), &st) == 0) {
+			if(!S_ISSOCK(st.st_mode)) {
+				error = "path exists and is not a socket";
+				return false;
+			}
+			unlink(path.c_str());
+		}
+		listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+		if(listen_fd < 0 || bind(listen_fd, (sockaddr*)&addr, sizeof addr) < 0 || listen(listen_fd, 64) < 0) {
+			error = strerror(errno);
+			if(listen_fd >= 0) close(listen_fd);
+			return false;
+		}
+		
+		vector<thread> pool;
+		for(int w = 0; w < workers; ++w) pool.emplace_back(&SolveServer::work, this);
+		while(true) {
+			const int fd = accept(listen_fd, nullptr, nullptr);
+			if(fd < 0) {
+				{
+					lock_guard<mutex> lk(m);
+					if(stop) break;
+				}
+				// A client that gave up, or no descriptors to spare right now
+				if(errno == EINTR || errno == ECONNABORTED || errno == EPROTO) continue;
+				if(errno == EMFILE || errno == ENFILE || errno == ENOBUFS || errno == ENOMEM) {
+					this_thread::sleep_for(chrono::milliseconds(100));
+					continue;
+				}
+				break;
+			}
+			shared_ptr<Client> client = make_shared<Client>(fd);
+			{
+				lock_guard<mutex> lk(m);
+				clients.erase(remove_if(clients.begin(), clients.end(),
+				                        [](const weak_ptr<Client>& c) { return c.expired(); }), clients.end());
+				clients.push_back(client);
+				++ readers;
+			}
+			thread([this, client] {
+				read(client);
+				lock_guard<mutex> lk(m);
+				if(-- readers == 0) readers_cv.notify_all();
+			}).detach();
+		}
+		shutdown_server();
+		
+		// Stop reading new jobs, let the queued ones finish and reply
+		unique_lock<mutex> lk(m);
+		for(const weak_ptr<Client>& c : clients)
+			if(shared_ptr<Client> client = c.lock()) ::shutdown(client->fd, SHUT_RD);
+		readers_cv.wait(lk, [&] { return readers == 0; });
+		lk.unlock();
+		for(thread& t : pool) t.join();
+		close(listen_fd);
+		unlink(path.c_str());
+		return true;
+	}
+};
+
+int main(int argc, char* argv[]) {
+	ios::sync_with_stdio(false);
+	cin.tie(nullptr);
+	
+	// Parse arguments
+	vector<string> map_names;
+	vector<string> input_files;
+	string serve_path;
+	bool step_threads_set = false;
+	RunOptions opt;
+	SolverParams& params = opt.params;
+	ParamFixFlags& fix_flags = opt.fix_flags;
 	
 	for(int i = 1; i < argc; ++i) {
 		string arg = argv[i];
 		if(arg == "-m" && i+1 < argc) {
-			map_name = argv[++i];
+			split_list(argv[++i], map_names);
+		} else if(arg == "--all") {
+			for(char c = 'A'; c <= 'F'; ++c) map_names.push_back(string(1, c));
+		} else if(arg == "--input" && i+1 < argc) {
+			split_list(argv[++i], input_files);
+		} else if(arg == "--serve" && i+1 < argc) {
+			serve_path = argv[++i];
 		} else if(arg == "-v" || arg == "--verbose") {
-			verbose = true;
+			opt.verbose = true;
 		} else if(arg == "--local-search") {
-			local_search_mode = true;
+			opt.local_search_mode = true;
 		} else if(arg == "--iterations" && i+1 < argc) {
-			iterations = stoi(argv[++i]);
+			opt.iterations = stoi(argv[++i]);
 		} else if(arg == "--seed" && i+1 < argc) {
-			seed = stoi(argv[++i]);
+			opt.seed = stoi(argv[++i]);
+		} else if(arg == "--step-threads" && i+1 < argc) {
+			opt.step_threads = max(1, stoi(argv[++i]));
+			step_threads_set = true;
+		} else if(arg == "--threads" && i+1 < argc) {
+			opt.threads = max(1, stoi(argv[++i]));
+		} else if(arg == "--tuner" && i+1 < argc) {
+			opt.tuner = argv[++i];
+		} else if(arg == "--time-limit" && i+1 < argc) {
+			opt.anytime.time_limit = stod(argv[++i]);
+		} else if(arg == "--checkpoint" && i+1 < argc) {
+			opt.anytime.checkpoint = argv[++i];
+		} else if(arg == "--checkpoint-every" && i+1 < argc) {
+			opt.anytime.checkpoint_every = stod(argv[++i]);
+		} else if(arg == "--trace" && i+1 < argc) {
+			opt.trace_file = argv[++i];
+		} else if(arg == "--resume" && i+1 < argc) {
+			opt.resume_file = argv[++i];
+		} else if(arg == "--lns" && i+1 < argc) {
+			opt.lns_iterations = max(0, stoi(argv[++i]));
+		} else if(arg == "--migrate-every" && i+1 < argc) {
+			opt.migrate_every = max(1, stoi(argv[++i]));
+		} else if(arg == "--candidate-k" && i+1 < argc) {
+			params.candidate_k = max(0, stoi(argv[++i]));
 		} else if(arg == "--task-eff" && i+1 < argc) {
 			params.task_efficiency_weight = stod(argv[++i]);
 		} else if(arg == "--dist-penalty" && i+1 < argc) {
@@ -622,14 +3396,80 @@ int main(int argc, char* argv[]) {
 		}
 	}
 	
-	if(map_name.empty()) {
-		cerr << "Usage: " << argv[0] << " -m <map> [options]" << endl;
+	// Server mode: the options become the defaults of every job and --threads
+	// the number of jobs solved at once. Files named on the command line would
+	// be shared by all jobs, so they are refused.
+	if(!serve_path.empty()) {
+		if(!opt.resume_file.empty() || !opt.trace_file.empty() || !opt.anytime.checkpoint.empty()) {
+			cerr << "--resume, --trace and --checkpoint cannot be used with --serve" << endl;
+			return 1;
+		}
+		int workers = opt.threads;
+		opt.threads = 1;
+		opt.write_profile = false;
+		SolveServer server(opt);
+		cout << "Serving on " << serve_path << " with " << workers << " workers" << endl;
+		string error;
+		if(!server.serve(serve_path, workers, error)) {
+			cerr << "Could not listen on " << serve_path << ": " << error << endl;
+			return 1;
+		}
+		return 0;
+	}
+	
+	bool usage = map_names.empty() && input_files.empty();
+	if(opt.tuner != "anneal" && opt.tuner != "cmaes" && opt.tuner != "halving") {
+		cerr << "Unknown tuner: " << opt.tuner << endl;
+		usage = true;
+	}
+	
+	vector<MapJob> jobs;
+	for(const string& name : map_names) {
+		string file = name.size() == 1 ? map_input(name[0]) : "";
+		if(file.empty()) {
+			cerr << "Unknown map: " << name << endl;
+			usage = true;
+			continue;
+		}
+		jobs.push_back({string(1, toupper(name[0])), file, string(1, tolower(name[0]))});
+	}
+	for(const string& file : input_files) {
+		// Named after the file, input/c_few_arms.txt writes output/c_few_arms_<score>.out
+		string stem = file.substr(file.find_last_of('/') + 1);
+		stem = stem.substr(0, stem.find('.'));
+		jobs.push_back({stem, file, stem});
+	}
+	if(jobs.size() > 1 && (!opt.resume_file.empty() || !opt.trace_file.empty() || !opt.anytime.checkpoint.empty())) {
+		cerr << "--resume, --trace and --checkpoint take a single map" << endl;
+		usage = true;
+	}
+	
+	if(usage) {
+		cerr << "Usage: " << argv[0] << " -m <map>[,<map>...] [options]" << endl;
 		cerr << "Maps: A, B, C, D, E, F" << endl;
 		cerr << "Options:" << endl;
+		cerr << "  --all                  Solve all maps A to F" << endl;
+		cerr << "  --input FILE[,FILE]    Solve the given input files as well" << endl;
+		cerr << "  --serve SOCKET         Keep running and solve JSON jobs sent to a Unix socket;" << endl;
+		cerr << "                         --threads jobs at once, other options are job defaults" << endl;
 		cerr << "  -v, --verbose          Enable console output" << endl;
 		cerr << "  --local-search         Enable local search" << endl;
 		cerr << "  --iterations N         Number of iterations (default: 50)" << endl;
+		cerr << "  --tuner NAME           Local search tuner: anneal, cmaes or halving (default: anneal)" << endl;
+		cerr << "  --time-limit SEC       Stop the local search after SEC seconds of wall clock" << endl;
+		cerr << "  --checkpoint FILE      Checkpoint the annealing search to FILE" << endl;
+		cerr << "                         (default with --time-limit: output/<map>_<seed>.ckpt)" << endl;
+		cerr << "  --checkpoint-every SEC Seconds between checkpoints (default: 300)" << endl;
+		cerr << "  --resume FILE          Continue the annealing search saved in FILE" << endl;
+		cerr << "  --trace FILE           Record every local search evaluation to FILE as JSONL" << endl;
 		cerr << "  --seed N               Random seed (default: random)" << endl;
+		cerr << "  --step-threads N       Threads evaluating candidates per greedy step (default: 1)" << endl;
+		cerr << "  --threads N            Parallel local search chains (default: 1); with several" << endl;
+		cerr << "                         maps, the workers shared by all maps, larger maps get more" << endl;
+		cerr << "                         (unless --step-threads sets the workers of each map)" << endl;
+		cerr << "  --migrate-every N      Iterations between chain migrations (default: 10)" << endl;
+		cerr << "  --lns N                Ruin-and-recreate iterations on the final params (default: 0)" << endl;
+		cerr << "  --candidate-k K        Only consider the K tasks starting nearest to the arm (default: all)" << endl;
 		cerr << "  --task-eff VALUE       Task efficiency weight (default: 1.0)" << endl;
 		cerr << "  --dist-penalty VALUE   Distance penalty (default: 1.0)" << endl;
 		cerr << "  --ownership-factor V   Ownership factor (default: 2.0)" << endl;
@@ -646,95 +3486,90 @@ int main(int argc, char* argv[]) {
 		return 1;
 	}
 	
-	string input_file = "input/" + string(1, tolower(map_name[0])) + "_";
-	if(map_name == "A") input_file += "example.txt";
-	else if(map_name == "B") input_file += "single_arm.txt";
-	else if(map_name == "C") input_file += "few_arms.txt";
-	else if(map_name == "D") input_file += "tight_schedule.txt";
-	else if(map_name == "E") input_file += "dense_workspace.txt";
-	else if(map_name == "F") input_file += "decentralized.txt";
+	// A resumed search keeps the seed, schedule, initial and fixed params it started with
+	Checkpoint resume;
+	if(!opt.resume_file.empty()) {
+		if(!resume.load(opt.resume_file)) {
+			cerr << "Could not read checkpoint: " << opt.resume_file << endl;
+			return 1;
+		}
+		opt.local_search_mode = true;
+		opt.tuner = "anneal";
+		opt.seed = resume.seed;
+		opt.iterations = resume.iterations;
+		opt.migrate_every = resume.migrate_every;
+		opt.threads = resume.chain.size();
+		params = resume.initial_params;
+		fix_flags = resume.fix_flags;
+		if(opt.anytime.checkpoint.empty()) opt.anytime.checkpoint = opt.resume_file;
+	}
 	
 	// Generate random seed if not provided
-	if(seed == -1) {
+	if(opt.seed == -1) {
 		random_device rd;
-		seed = rd();
+		opt.seed = rd();
 	}
 	
-	cout << "Simulation parameters:" << endl;
-	cout << "Map: " << map_name << endl;
-	cout << "Seed: " << seed << endl;
-	cout << "Local Search: " << (local_search_mode ? "true" : "false") << endl;
-	if(local_search_mode) {
-		cout << "Iterations: " << iterations << endl;
-		fix_flags.print();
+	// Read every input once, up front
+	vector<unique_ptr<Instance>> ins;
+	PROF_TIMER(preprocess_ns);
+	for(const MapJob& job : jobs) {
+		ins.emplace_back(new Instance());
+		if(!ins.back()->load(job.input_file)) {
+			cerr << "Could not read input: " << job.input_file << endl;
+			return 1;
+		}
 	}
-	cout << "Initial params: ";
-	params.print();
-	
-	// Read input
-	ifstream in(input_file);
-	if(!in) {
-		cerr << "Could not open file: " << input_file << endl;
+	PROF_STOP(preprocess_ns);
+	if(!opt.resume_file.empty() && !resume.matches(*ins[0])) {
+		cerr << "Checkpoint " << opt.resume_file << " belongs to another input than " << jobs[0].input_file << endl;
 		return 1;
 	}
 	
-	int W, H, R, M, T, L;
-	in >> W >> H >> R >> M >> T >> L;
-	
-	vector<Point> ms(M);
-	for(int i = 0; i < M; ++i) in >> ms[i].x >> ms[i].y;
-	
-	vi S(T), Len(T, 0);
-	vector<vector<Point>> P(T);
-	for(int t = 0; t < T; ++t) {
-		int p;
-		in >> S[t] >> p;
-		P[t].reserve(p);
-		while(p--) {
-			int x, y;
-			in >> x >> y;
-			P[t].emplace_back(x, y);
-		}
-		for(int i = 1; i < P[t].size(); ++i) Len[t] += distance(P[t][i-1], P[t][i]);
+	if(jobs.size() == 1) {
+		MapResult res = solve_map(jobs[0], *ins[0], opt, opt.resume_file.empty() ? nullptr : &resume, cout, cerr);
+		return res.score < 0 ? 1 : 0;
 	}
 	
-	// Solve with timing
+	// Several maps run side by side. --threads is the worker budget of the
+	// whole run; each map spends its share on its greedy steps, which pick
+	// the same moves at any thread count, so the outputs match single-map
+	// runs with one chain. An explicit --step-threads gives every map that
+	// many instead. Shares are fixed up front: the workers of a map that
+	// finishes early are not handed to the others.
+	int n = jobs.size();
+	vi share = step_threads_set ? vi(n, opt.step_threads) : share_workers(ins, opt.threads);
+	vector<MapResult> results(n);
+	mutex print_m;
+	ThreadPool map_pool(n);
 	auto start_time = chrono::steady_clock::now();
+	map_pool.parallel_for(n, [&](int, int k) {
+		RunOptions job_opt = opt;
+		job_opt.threads = 1;
+		job_opt.write_profile = false;
+		job_opt.step_threads = share[k];
+		ostringstream out, err;
+		results[k] = solve_map(jobs[k], *ins[k], job_opt, nullptr, out, err);
+		lock_guard<mutex> lk(print_m);
+		cerr << err.str();
+		cout << "\n" << out.str();
+		cout.flush();
+	});
+	double total_seconds = chrono::duration<double>(chrono::steady_clock::now() - start_time).count();
 	
-	vector<Arm> arms;
-	int score;
-	SolverParams final_params = params;
-	
-	if(local_search_mode) {
-		auto [best_arms, best_score, final_params_result] = local_search(
-			W, H, R, M, T, L, ms, S, P, Len, params, iterations, seed, verbose, fix_flags
-		);
-		arms = best_arms;
-		score = best_score;
-		final_params = final_params_result;
-	} else {
-		mt19937 mt(seed);
-		score = greedy_solver(W, H, R, M, T, L, ms, S, P, Len, arms, params, mt, verbose);
-		final_params = params;
+	size_t width = 3;
+	for(const MapJob& job : jobs) width = max(width, job.name.size());
+	cout << "\nSummary:" << endl;
+	cout << left << setw(width + 2) << "Map" << right << setw(12) << "Score" << setw(10) << "Time" << setw(10) << "Workers" << "  Output" << endl;
+	bool failed = false;
+	for(int k = 0; k < n; ++k) {
+		failed |= results[k].score < 0;
+		cout << left << setw(width + 2) << jobs[k].name << right << setw(12) << results[k].score
+		     << setw(9) << fixed << setprecision(1) << results[k].seconds << "s" << setw(10) << share[k]
+		     << "  " << results[k].output_file << endl;
 	}
+	cout << "Total: " << fixed << setprecision(1) << total_seconds << "s" << endl;
 	
-	auto end_time = chrono::steady_clock::now();
-	double execution_time_seconds = chrono::duration<double>(end_time - start_time).count();
-	double execution_time_minutes = execution_time_seconds / 60.0;
-	
-	// Write output
-	string base_name = string(1, tolower(map_name[0]));
-	string output_file = "output/" + base_name + "_" + to_string(score) + ".out";
-	write_output(arms, output_file);
-	
-	// Write params JSON file with same base name
-	string json_file = "output/" + base_name + "_" + to_string(score) + ".json";
-	write_params_json(json_file, params, final_params, fix_flags, 
-	                 map_name, score, iterations, seed, local_search_mode, execution_time_minutes);
-	
-	cout << "\nFinal score: " << (score < 1000 ? to_string(score) : to_string(score/1000) + " K") << endl;
-	cout << "Saved: " << output_file << endl;
-	cout << "Params: " << json_file << endl;
-	
-	return 0;
-}
\ No newline at end of file
+	return failed ? 1 : 0;
+}
+#endif